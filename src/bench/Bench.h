@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BENCH_H
+#define BENCH_H 1
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <utility>
+
+namespace asiodemo { namespace bench {
+
+/// a benchmark returns false if one of its checks failed
+typedef bool (*BenchFunc)();
+
+/// registers a benchmark with asiodemo_bench, use BENCHMARK()
+struct Registration {
+  Registration(char const* name, BenchFunc func);
+};
+
+#define BENCHMARK(name)                                                  \
+  static bool bench_##name();                                            \
+  static ::asiodemo::bench::Registration registration_##name(#name,      \
+                                                             &bench_##name); \
+  static bool bench_##name()
+
+/// keep the compiler from optimizing away the computation of `value`
+template <typename T>
+inline void doNotOptimize(T const& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/// run `fn` `iterations` times and print the time per iteration,
+/// returns the nanoseconds per iteration
+template <typename F>
+double measure(char const* label, size_t iterations, F&& fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    fn(i);
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  double perOp = elapsed.count() / iterations;
+  std::printf("  %-44s %12.1f ns/op\n", label, perOp);
+  return perOp;
+}
+
+/// print a failed check, for the return value of a benchmark
+inline bool check(bool ok, char const* what) {
+  if (!ok) {
+    std::printf("  FAILED: %s\n", what);
+  }
+  return ok;
+}
+
+}}  // namespace asiodemo::bench
+
+#endif
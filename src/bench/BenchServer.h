@@ -0,0 +1,193 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BENCH_SERVER_H
+#define BENCH_SERVER_H 1
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <asio/connect.hpp>
+#include <asio/io_context.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/local/stream_protocol.hpp>
+#include <asio/read.hpp>
+#include <asio/write.hpp>
+
+#include "rest/Server.h"
+
+namespace asiodemo { namespace bench {
+
+/// Server running on a thread of the benchmark process. Uses ports
+/// 18080 and 18443, so it does not collide with a running demo server.
+/// The TLS listener needs the certificate the demo server uses.
+class BenchServer {
+ public:
+  static constexpr int HttpPort = 18080;
+
+  /// options of a small server answering "/" with a short body
+  static rest::ServerOptions defaultOptions() {
+    rest::ServerOptions options;
+    options.ioThreads = 1;
+    options.pinThreads = false;
+    options.httpPort = HttpPort;
+    options.httpsPort = 18443;
+    options.drainTimeout = std::chrono::seconds(1);
+    return options;
+  }
+
+  explicit BenchServer(rest::ServerOptions options = defaultOptions())
+      : _server(std::move(options)) {
+    _server.addHandler("/", [](rest::Request const&) {
+      auto res = std::make_unique<rest::Response>();
+      res->status_code = rest::ResponseCode::OK;
+      res->body = std::make_unique<std::string>("Hello World");
+      return res;
+    });
+  }
+  ~BenchServer() { stop(); }
+
+  rest::Server& server() { return _server; }
+
+  /// serve on a new thread, clients retry until the listeners are open
+  void start() {
+    _thread = std::thread([this]() { _server.listenAndServe(); });
+  }
+
+  /// the server waits for SIGTERM like the demo server
+  void stop() {
+    if (_thread.joinable()) {
+      ::kill(::getpid(), SIGTERM);
+      _thread.join();
+    }
+  }
+
+ private:
+  rest::Server _server;
+  std::thread _thread;
+};
+
+/// Blocking HTTP/1.1 client on one keep-alive connection, `Socket` is
+/// a TCP or a unix domain stream socket
+template <typename Socket>
+class HttpClient {
+ public:
+  /// connect to `endpoint`, retries for a while until the server listens
+  template <typename Endpoint>
+  HttpClient(asio::io_context& ctx, Endpoint const& endpoint) : _socket(ctx) {
+    asio::error_code ec;
+    for (int i = 0; i < 500; ++i) {
+      _socket.connect(endpoint, ec);
+      if (!ec) {
+        break;
+      }
+      _socket.close(ec);
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (!_socket.is_open()) {
+      std::fprintf(stderr, "unable to connect to the benchmark server\n");
+      std::exit(1);
+    }
+  }
+
+  /// GET `path` and read the whole response, returns the status code
+  /// or -1 if the connection failed
+  int get(std::string_view path) {
+    _request.assign("GET ").append(path).append(
+        " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    asio::error_code ec;
+    asio::write(_socket, asio::buffer(_request), ec);
+    if (ec) {
+      return -1;
+    }
+
+    size_t headerEnd;
+    while ((headerEnd = _buffer.find("\r\n\r\n")) == std::string::npos) {
+      if (!readSome()) {
+        return -1;
+      }
+    }
+    headerEnd += 4;
+    size_t length = 0;
+    size_t pos = _buffer.find("Content-Length: ");
+    if (pos != std::string::npos && pos < headerEnd) {
+      length = std::strtoull(_buffer.c_str() + pos + 16, nullptr, 10);
+    }
+    while (_buffer.size() < headerEnd + length) {
+      if (!readSome()) {
+        return -1;
+      }
+    }
+    int status = std::atoi(_buffer.c_str() + 9);  // "HTTP/1.1 200"
+    _buffer.erase(0, headerEnd + length);
+    return status;
+  }
+
+ private:
+  bool readSome() {
+    char buf[4096];
+    asio::error_code ec;
+    size_t n = _socket.read_some(asio::buffer(buf), ec);
+    _buffer.append(buf, n);
+    return !ec;
+  }
+
+ private:
+  Socket _socket;
+  std::string _request;
+  std::string _buffer;
+};
+
+typedef HttpClient<asio::ip::tcp::socket> TcpClient;
+
+inline asio::ip::tcp::endpoint loopback(int port) {
+  return asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(),
+                                 static_cast<unsigned short>(port));
+}
+
+/// round trip times in microseconds, sorts `samples`
+inline void printLatency(char const* label, std::vector<double>& samples) {
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (double s : samples) {
+    sum += s;
+  }
+  auto at = [&](double q) {
+    return samples[static_cast<size_t>(q * (samples.size() - 1))];
+  };
+  std::printf("  %-28s mean %7.1f  p50 %7.1f  p99 %7.1f  max %8.1f us\n",
+              label, sum / samples.size(), at(0.5), at(0.99),
+              samples.back());
+}
+
+/// `n` sequential requests on `client`, returns false if one failed
+template <typename Client>
+bool measureLatency(char const* label, Client& client, size_t n) {
+  std::vector<double> samples;
+  samples.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    if (client.get("/") != 200) {
+      return false;
+    }
+    std::chrono::duration<double, std::micro> rtt =
+        std::chrono::steady_clock::now() - start;
+    samples.push_back(rtt.count());
+  }
+  printLatency(label, samples);
+  return true;
+}
+
+}}  // namespace asiodemo::bench
+
+#endif
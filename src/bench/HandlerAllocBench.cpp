@@ -0,0 +1,50 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Bench.h"
+#include "BenchServer.h"
+
+#include "rest/HandlerMemory.h"
+
+using namespace asiodemo;
+using namespace asiodemo::bench;
+
+namespace {
+
+bool run(char const* label, bool syncWrite) {
+  rest::ServerOptions options = BenchServer::defaultOptions();
+  options.syncWrite = syncWrite;
+  BenchServer server(std::move(options));
+  server.start();
+
+  bool ok = true;
+  {
+    asio::io_context ctx;
+    TcpClient client(ctx, loopback(BenchServer::HttpPort));
+    for (int i = 0; i < 1000 && ok; ++i) {  // warm up
+      ok = client.get("/") == 200;
+    }
+    uint64_t before = rest::HandlerMemory::heapAllocations();
+    constexpr size_t Requests = 100000;
+    measure(label, Requests,
+            [&](size_t) { ok = client.get("/") == 200 && ok; });
+    uint64_t allocations = rest::HandlerMemory::heapAllocations() - before;
+    std::printf("  handler allocations on the heap: %llu\n",
+                static_cast<unsigned long long>(allocations));
+    ok = check(ok, "all requests answered") &&
+         check(allocations == 0, "no heap allocations in steady state");
+  }
+  server.stop();
+  return ok;
+}
+
+}  // namespace
+
+/// keep-alive requests over loopback TCP, asserts that the handlers of
+/// the read -> parse -> write loop never fall back to the heap, with
+/// and without the synchronous write
+BENCHMARK(handlerAllocations) {
+  bool ok = run("request, synchronous write first", true);
+  return run("request, async_write only", false) && ok;
+}
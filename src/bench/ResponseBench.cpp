@@ -0,0 +1,285 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Bench.h"
+
+#include <cctype>
+#include <string>
+
+#include "rest/CommonHeaders.h"
+#include "rest/Response.h"
+
+using namespace asiodemo;
+using namespace asiodemo::bench;
+using namespace asiodemo::rest;
+
+namespace {
+
+constexpr size_t Iterations = 1000000;
+
+/// the serialization Response::writeHeader() replaced, kept as baseline
+namespace previous {
+
+std::string responseString(ResponseCode status_code) {
+  switch (status_code) {
+    //  Informational 1xx
+    case ResponseCode::CONTINUE:
+      return "100 Continue";
+    case ResponseCode::SWITCHING_PROTOCOLS:
+      return "101 Switching Protocols";
+    case ResponseCode::PROCESSING:
+      return "102 Processing";
+
+    //  Success 2xx
+    case ResponseCode::OK:
+      return "200 OK";
+    case ResponseCode::CREATED:
+      return "201 Created";
+    case ResponseCode::ACCEPTED:
+      return "202 Accepted";
+    case ResponseCode::PARTIAL:
+      return "203 Non-Authoritative Information";
+    case ResponseCode::NO_CONTENT:
+      return "204 No Content";
+    case ResponseCode::RESET_CONTENT:
+      return "205 Reset Content";
+    case ResponseCode::PARTIAL_CONTENT:
+      return "206 Partial Content";
+
+    //  Redirection 3xx
+    case ResponseCode::MOVED_PERMANENTLY:
+      return "301 Moved Permanently";
+    case ResponseCode::FOUND:
+      return "302 Found";
+    case ResponseCode::SEE_OTHER:
+      return "303 See Other";
+    case ResponseCode::NOT_MODIFIED:
+      return "304 Not Modified";
+    case ResponseCode::TEMPORARY_REDIRECT:
+      return "307 Temporary Redirect";
+    case ResponseCode::PERMANENT_REDIRECT:
+      return "308 Permanent Redirect";
+
+    //  Client Error 4xx
+    case ResponseCode::BAD:
+      return "400 Bad Request";
+    case ResponseCode::UNAUTHORIZED:
+      return "401 Unauthorized";
+    case ResponseCode::PAYMENT_REQUIRED:
+      return "402 Payment Required";
+    case ResponseCode::FORBIDDEN:
+      return "403 Forbidden";
+    case ResponseCode::NOT_FOUND:
+      return "404 Not Found";
+    case ResponseCode::METHOD_NOT_ALLOWED:
+      return "405 Method Not Allowed";
+    case ResponseCode::NOT_ACCEPTABLE:
+      return "406 Not Acceptable";
+    case ResponseCode::REQUEST_TIMEOUT:
+      return "408 Request Timeout";
+    case ResponseCode::CONFLICT:
+      return "409 Conflict";
+    case ResponseCode::GONE:
+      return "410 Gone";
+    case ResponseCode::LENGTH_REQUIRED:
+      return "411 Length Required";
+    case ResponseCode::PRECONDITION_FAILED:
+      return "412 Precondition Failed";
+    case ResponseCode::REQUEST_ENTITY_TOO_LARGE:
+      return "413 Payload Too Large";
+    case ResponseCode::REQUEST_URI_TOO_LONG:
+      return "414 Request-URI Too Long";
+    case ResponseCode::UNSUPPORTED_MEDIA_TYPE:
+      return "415 Unsupported Media Type";
+    case ResponseCode::REQUESTED_RANGE_NOT_SATISFIABLE:
+      return "416 Requested Range Not Satisfiable";
+    case ResponseCode::EXPECTATION_FAILED:
+      return "417 Expectation Failed";
+    case ResponseCode::I_AM_A_TEAPOT:
+      return "418 I'm a teapot";
+    case ResponseCode::UNPROCESSABLE_ENTITY:
+      return "422 Unprocessable Entity";
+    case ResponseCode::LOCKED:
+      return "423 Locked";
+    case ResponseCode::PRECONDITION_REQUIRED:
+      return "428 Precondition Required";
+    case ResponseCode::TOO_MANY_REQUESTS:
+      return "429 Too Many Requests";
+    case ResponseCode::REQUEST_HEADER_FIELDS_TOO_LARGE:
+      return "431 Request Header Fields Too Large";
+    case ResponseCode::UNAVAILABLE_FOR_LEGAL_REASONS:
+      return "451 Unavailable For Legal Reasons";
+
+    //  Server Error 5xx
+    case ResponseCode::SERVER_ERROR:
+      return "500 Internal Server Error";
+    case ResponseCode::NOT_IMPLEMENTED:
+      return "501 Not Implemented";
+    case ResponseCode::BAD_GATEWAY:
+      return "502 Bad Gateway";
+    case ResponseCode::SERVICE_UNAVAILABLE:
+      return "503 Service Unavailable";
+    case ResponseCode::HTTP_VERSION_NOT_SUPPORTED:
+      return "505 HTTP Version Not Supported";
+    case ResponseCode::BANDWIDTH_LIMIT_EXCEEDED:
+      return "509 Bandwidth Limit Exceeded";
+    case ResponseCode::NOT_EXTENDED:
+      return "510 Not Extended";
+
+    // default
+    default: {
+      auto code = status_code;
+      // print generic group responses, based on error code group
+      int group = ((int)code) / 100;
+      switch (group) {
+        case 1:
+          return std::to_string((int)code) + " Informational";
+        case 2:
+          return std::to_string((int)code) + " Success";
+        case 3:
+          return std::to_string((int)code) + " Redirection";
+        case 4:
+          return std::to_string((int)code) + " Client error";
+        case 5:
+          return std::to_string((int)code) + " Server error";
+        default:
+          break;
+      }
+    }
+  }
+
+  return std::to_string((int)status_code) + " Unknown";
+}
+
+std::unique_ptr<std::string> generateHeader(Response const& res) {
+  auto header = std::make_unique<std::string>();
+  header->reserve(220);
+
+  header->append("HTTP/1.1 ");
+  header->append(responseString(res.status_code));
+  header->append("\r\n", 2);
+
+  for (auto const& it : res.headers) {
+    std::string const& key = it.name;
+    size_t const keyLength = key.size();
+    // ignore content-length
+    KnownHeader known = headers::classify(it.hash, key);
+    if (known == KnownHeader::ContentLength ||
+        known == KnownHeader::Connection ||
+        known == KnownHeader::TransferEncoding) {
+      continue;
+    }
+
+    // reserve enough space for header name + ": " + value + "\r\n"
+    header->reserve(key.size() + 2 + it.value.size() + 2);
+
+    char const* p = key.data();
+    char const* end = p + keyLength;
+    int capState = 1;
+    while (p < end) {
+      if (capState == 1) {
+        // upper case
+        header->push_back(::toupper(*p));
+        capState = 0;
+      } else if (capState == 0) {
+        // normal case
+        header->push_back(::tolower(*p));
+        if (*p == '-') {
+          capState = 1;
+        } else if (*p == ':') {
+          capState = 2;
+        }
+      } else {
+        // output as is
+        header->push_back(*p);
+      }
+      ++p;
+    }
+
+    header->append(": ", 2);
+    header->append(it.value);
+    header->append("\r\n", 2);
+  }
+
+  // add "Content-Type" header
+  header->append("Content-Type: text/plain; charset=utf-8\r\n");
+
+  // Cookies
+  for (auto const& it : res.cookies) {
+    header->append("Set-Cookie: ");
+    header->append(it);
+    header->append("\r\n", 2);
+  }
+
+  header->append("Content-Length: ");
+  if (res.body) {
+    header->append(std::to_string(res.body->size()));
+  } else {
+    header->append("0");
+  }
+  header->append("\r\n", 2);
+
+  header->append("Connection: Keep-Alive\r\n");
+  header->append("Keep-Alive: timeout=60");
+  header->append("\r\n\r\n");
+
+  return header;
+}
+
+}  // namespace previous
+
+void compare(char const* name, Response const& res) {
+  std::printf("  %s\n", name);
+  measure("previous generateHeader()", Iterations,
+          [&](size_t) { doNotOptimize(previous::generateHeader(res)); });
+  measure("generateHeader()", Iterations,
+          [&](size_t) { doNotOptimize(res.generateHeader()); });
+  // the connection appends to a reused buffer
+  std::string buffer;
+  measure("writeHeader() into a reused buffer", Iterations, [&](size_t) {
+    buffer.clear();
+    res.writeHeader(buffer);
+    doNotOptimize(buffer.data());
+  });
+}
+
+}  // namespace
+
+/// header serialization of typical responses, the current one against
+/// the implementation it replaced
+BENCHMARK(responseHeader) {
+  // the Date header is formatted once a second, as on the io threads
+  CommonHeaders::tick();
+
+  Response notFound;
+  notFound.status_code = ResponseCode::NOT_FOUND;
+  compare("404 without headers", notFound);
+
+  Response json;
+  json.status_code = ResponseCode::OK;
+  json.headers.add("content-type", "application/json; charset=utf-8");
+  json.headers.add("x-request-id", "2f1c9a7e-4b1d-4c8e-9a51-0d6f3e2b7c44");
+  json.body = std::make_unique<std::string>(1234, 'x');
+  compare("200 with two headers and a body", json);
+
+  Response many;
+  many.status_code = ResponseCode::CREATED;
+  many.headers.add("content-type", "text/html; charset=utf-8");
+  many.headers.add("cache-control", "no-cache, no-store, must-revalidate");
+  many.headers.add("location", "/api/v1/resource17/4711");
+  many.headers.add("access-control-allow-origin", "https://example.com");
+  many.headers.add("access-control-expose-headers", "etag, location");
+  many.headers.add("x-content-type-options", "nosniff");
+  many.cookies.push_back("session=8a3e77f1d2; Path=/; HttpOnly; Secure");
+  many.body = std::make_unique<std::string>(98765, 'x');
+  compare("201 with six headers and a cookie", many);
+
+  std::string current;
+  json.writeHeader(current);
+  std::string old = *previous::generateHeader(json);
+  return check(current.compare(0, 17, old, 0, 17) == 0 &&
+                   current.find("Content-Length: 1234\r\n") !=
+                       std::string::npos,
+               "the same status line and Content-Length");
+}
@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Bench.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "rest/Router.h"
+
+using namespace asiodemo;
+using namespace asiodemo::bench;
+using namespace asiodemo::rest;
+
+namespace {
+
+constexpr size_t Resources = 100;
+constexpr size_t Iterations = 2000000;
+
+Route makeRoute() {
+  Route route;
+  route.handler = [](Request const&) { return std::unique_ptr<Response>(); };
+  return route;
+}
+
+/// 12 routes per resource, static, parameter and catch-all patterns
+void addRoutes(Router& router, size_t& count) {
+  for (size_t i = 0; i < Resources; ++i) {
+    std::string base = "/api/v1/resource" + std::to_string(i);
+    router.add(Request::Type::GET, base, makeRoute());
+    router.add(Request::Type::POST, base, makeRoute());
+    router.add(Request::Type::GET, base + "/stats", makeRoute());
+    router.add(Request::Type::GET, base + "/search", makeRoute());
+    router.add(Request::Type::GET, base + "/:id", makeRoute());
+    router.add(Request::Type::PUT, base + "/:id", makeRoute());
+    router.add(Request::Type::DELETE_REQ, base + "/:id", makeRoute());
+    router.add(Request::Type::GET, base + "/:id/items", makeRoute());
+    router.add(Request::Type::POST, base + "/:id/items", makeRoute());
+    router.add(Request::Type::GET, base + "/:id/items/:item", makeRoute());
+    router.add(Request::Type::GET, "/static/v" + std::to_string(i) + "/*path",
+               makeRoute());
+    router.add(Request::Type::ILLEGAL, "/hooks/h" + std::to_string(i),
+               makeRoute());
+    count += 12;
+  }
+}
+
+bool lookup(char const* label, Router const& router, Request::Type method,
+            std::vector<std::string> const& paths, Router::Match expected) {
+  Request req;
+  req.method = method;
+  bool ok = true;
+  measure(label, Iterations, [&](size_t i) {
+    req.path = paths[i % paths.size()];
+    Router::Match match;
+    doNotOptimize(router.find(req, match));
+    ok = ok && match == expected;
+  });
+  return check(ok, label);
+}
+
+}  // namespace
+
+/// Router::find() with 1200 routes registered, and the exact match
+/// std::map lookup the router replaced for comparison
+BENCHMARK(router) {
+  Router router;
+  size_t count = 0;
+  addRoutes(router, count);
+  std::printf("  %zu routes\n", count);
+
+  std::vector<std::string> statics, params, deep, catchAll, missing;
+  for (size_t i = 0; i < Resources; i += 7) {
+    std::string base = "/api/v1/resource" + std::to_string(i);
+    statics.push_back(base + "/stats");
+    params.push_back(base + "/" + std::to_string(i * 31));
+    deep.push_back(base + "/" + std::to_string(i) + "/items/abc" +
+                   std::to_string(i));
+    catchAll.push_back("/static/v" + std::to_string(i) + "/css/site.css");
+    missing.push_back(base + "/" + std::to_string(i) + "/unknown");
+  }
+
+  bool ok = true;
+  ok = lookup("static path", router, Request::Type::GET, statics,
+              Router::Match::Found) && ok;
+  ok = lookup("one parameter", router, Request::Type::GET, params,
+              Router::Match::Found) && ok;
+  ok = lookup("two parameters", router, Request::Type::GET, deep,
+              Router::Match::Found) && ok;
+  ok = lookup("catch-all", router, Request::Type::GET, catchAll,
+              Router::Match::Found) && ok;
+  ok = lookup("not found", router, Request::Type::GET, missing,
+              Router::Match::NotFound) && ok;
+  ok = lookup("method not allowed", router, Request::Type::PATCH, params,
+              Router::Match::MethodNotAllowed) && ok;
+
+  // the former handler table, exact matches only
+  std::map<std::string, Route> exact;
+  for (size_t i = 0; i < count; ++i) {
+    exact.emplace("/api/v1/resource" + std::to_string(i / 12) + "/r" +
+                      std::to_string(i % 12),
+                  makeRoute());
+  }
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < count; i += 97) {
+    keys.push_back("/api/v1/resource" + std::to_string(i / 12) + "/r" +
+                   std::to_string(i % 12));
+  }
+  measure("std::map exact match (previous router)", Iterations,
+          [&](size_t i) { doNotOptimize(exact.find(keys[i % keys.size()])); });
+  return ok;
+}
@@ -0,0 +1,37 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Bench.h"
+#include "BenchServer.h"
+
+using namespace asiodemo;
+using namespace asiodemo::bench;
+
+namespace {
+
+bool run(char const* label, bool syncWrite) {
+  rest::ServerOptions options = BenchServer::defaultOptions();
+  options.syncWrite = syncWrite;
+  BenchServer server(std::move(options));
+  server.start();
+  bool ok;
+  {
+    asio::io_context ctx;
+    TcpClient client(ctx, loopback(BenchServer::HttpPort));
+    ok = measureLatency("warm-up", client, 1000) &&
+         measureLatency(label, client, 50000);
+  }
+  server.stop();
+  return check(ok, "all requests answered");
+}
+
+}  // namespace
+
+/// request latency with ServerOptions::syncWrite on and off: the
+/// response written inline by the handler against a round trip through
+/// the reactor for every async_write
+BENCHMARK(syncWrite) {
+  bool ok = run("async_write only", false);
+  return run("synchronous write first", true) && ok;
+}
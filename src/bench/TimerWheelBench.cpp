@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Bench.h"
+
+#include <memory>
+#include <vector>
+
+#include <asio/io_context.hpp>
+#include <asio/steady_timer.hpp>
+
+#include "rest/TimerWheel.h"
+
+using namespace asiodemo;
+using namespace asiodemo::bench;
+using namespace asiodemo::rest;
+
+namespace {
+
+/// idle keep-alive connections, each with a pending timeout
+constexpr size_t Connections = 200000;
+constexpr size_t Iterations = 2000000;
+constexpr std::chrono::seconds KeepAlive(60);
+
+/// spread the re-armed connections over the whole set
+size_t pick(size_t i) { return (i * 7919) % Connections; }
+
+bool wheel() {
+  TimerWheel wheel;
+  std::vector<std::unique_ptr<TimerWheel::Entry>> entries(Connections);
+  size_t expired = 0;
+  for (auto& entry : entries) {
+    entry = std::make_unique<TimerWheel::Entry>();
+    entry->callback = [&expired]() { ++expired; };
+    wheel.schedule(*entry, KeepAlive);
+  }
+  std::printf("  %zu connections, %zu bytes per timeout\n", Connections,
+              sizeof(TimerWheel::Entry));
+
+  // every response pushes the deadline of its connection
+  measure("timer wheel: re-arm", Iterations,
+          [&](size_t i) { wheel.schedule(*entries[pick(i)], KeepAlive); });
+  measure("timer wheel: cancel and arm", Iterations, [&](size_t i) {
+    TimerWheel::Entry& entry = *entries[pick(i)];
+    entry.cancel();
+    wheel.schedule(entry, KeepAlive);
+  });
+  // the io thread ticks once a second while all connections idle
+  measure("timer wheel: tick, nothing expires", KeepAlive.count() - 1,
+          [&](size_t) { wheel.tick(); });
+  bool ok = check(expired == 0, "no timeout before the deadline");
+
+  measure("timer wheel: tick expiring all", 2, [&](size_t) { wheel.tick(); });
+  return check(ok && expired == Connections, "every timeout fired once");
+}
+
+/// the asio::steady_timer per socket the wheel replaced
+void steadyTimer() {
+  asio::io_context ctx;
+  std::vector<std::unique_ptr<asio::steady_timer>> timers(Connections);
+  for (auto& timer : timers) {
+    timer = std::make_unique<asio::steady_timer>(ctx);
+    timer->expires_after(KeepAlive);
+    timer->async_wait([](asio::error_code const&) {});
+  }
+  std::printf("  %zu bytes per asio::steady_timer\n",
+              sizeof(asio::steady_timer));
+
+  // cancels the pending wait, its handler runs with operation_aborted
+  measure("steady_timer: re-arm and run the aborted wait", Iterations / 4,
+          [&](size_t i) {
+            asio::steady_timer& timer = *timers[pick(i)];
+            timer.expires_after(KeepAlive);
+            timer.async_wait([](asio::error_code const&) {});
+            ctx.poll();
+          });
+  for (auto& timer : timers) {
+    timer->cancel();
+  }
+  ctx.poll();
+}
+
+}  // namespace
+
+/// timeouts of 200k idle connections on one io thread: the timer wheel
+/// against a steady_timer per connection
+BENCHMARK(timerWheel) {
+  bool ok = wheel();
+  steadyTimer();
+  return ok;
+}
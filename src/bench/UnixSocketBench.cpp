@@ -0,0 +1,37 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Bench.h"
+#include "BenchServer.h"
+
+using namespace asiodemo;
+using namespace asiodemo::bench;
+
+/// request latency of a local client over loopback TCP and over the
+/// unix domain socket listener of the same server
+BENCHMARK(unixSocket) {
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+  rest::ServerOptions options = BenchServer::defaultOptions();
+  options.unixSocketPath = "/tmp/asiodemo_bench.sock";
+  BenchServer server(options);
+  server.start();
+
+  bool ok;
+  {
+    asio::io_context ctx;
+    TcpClient tcp(ctx, loopback(BenchServer::HttpPort));
+    HttpClient<asio::local::stream_protocol::socket> uds(
+        ctx, asio::local::stream_protocol::endpoint(options.unixSocketPath));
+    ok = measureLatency("warm-up TCP", tcp, 1000) &&
+         measureLatency("warm-up unix socket", uds, 1000) &&
+         measureLatency("loopback TCP", tcp, 50000) &&
+         measureLatency("unix domain socket", uds, 50000);
+  }
+  server.stop();
+  return check(ok, "all requests answered");
+#else
+  std::printf("  unix domain sockets are not supported on this platform\n");
+  return true;
+#endif
+}
@@ -0,0 +1,40 @@
+#include "Bench.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace asiodemo;
+
+namespace {
+struct Benchmark {
+  char const* name;
+  bench::BenchFunc func;
+};
+
+std::vector<Benchmark>& benchmarks() {
+  static std::vector<Benchmark> list;
+  return list;
+}
+}  // namespace
+
+bench::Registration::Registration(char const* name, BenchFunc func) {
+  benchmarks().push_back(Benchmark{name, func});
+}
+
+/// asiodemo_bench [name...] runs all benchmarks or the ones named,
+/// exits with 1 if a check failed
+int main(int argc, char* argv[]) {
+  bool ok = true;
+  for (Benchmark const& b : benchmarks()) {
+    bool selected = argc < 2;
+    for (int i = 1; i < argc; ++i) {
+      selected = selected || std::strcmp(argv[i], b.name) == 0;
+    }
+    if (selected) {
+      std::printf("%s\n", b.name);
+      std::fflush(stdout);
+      ok = b.func() && ok;
+    }
+  }
+  return ok ? 0 : 1;
+}
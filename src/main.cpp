@@ -1,12 +1,22 @@
 
 #include "rest/Server.h"
 
+#include <chrono>
+#include <thread>
+
 using namespace asiodemo;
 
-int main() {
-  rest::Server server;
+int main(int argc, char* argv[]) {
+  rest::ServerOptions options;
+  // SIGUSR2 starts the (new) binary, it takes over the listening sockets
+  options.upgradeCommand.assign(argv, argv + argc);
+  options.workerThreads = 2;
+  options.handshakeThreads = 1;
+  options.kernelTls = true;
+  options.unixSocketPath = "/tmp/asiodemo.sock";
+  rest::Server server(options);
 
-  server.addHandler("/", [](rest::Request) {
+  server.addHandler("/", [](rest::Request const&) {
     auto res = std::make_unique<rest::Response>();
     res->status_code = rest::ResponseCode::OK;
     res->body = std::make_unique<std::string>();
@@ -14,7 +24,7 @@ int main() {
     return res;
   });
 
-  server.addHandler("/abcd", [](rest::Request) {
+  server.addHandler("/abcd", [](rest::Request const&) {
     auto res = std::make_unique<rest::Response>();
     res->status_code = rest::ResponseCode::OK;
     res->body = std::make_unique<std::string>();
@@ -22,5 +32,58 @@ int main() {
     return res;
   });
 
+  // blocking handler, runs on the worker pool instead of an io thread
+  server.addHandler(
+      rest::Request::Type::GET, "/slow",
+      [](rest::Request const&) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        auto res = std::make_unique<rest::Response>();
+        res->status_code = rest::ResponseCode::OK;
+        res->body = std::make_unique<std::string>("Hello Slow World");
+        return res;
+      },
+      *server.workerPool());
+
+  // counts the bytes of an upload without buffering it
+  server.addStreamingHandler(
+      rest::Request::Type::POST, "/upload",
+      [](rest::Request const&, rest::BodyControl) {
+        struct Counter : rest::BodyConsumer {
+          size_t bytes = 0;
+          bool onData(std::string_view chunk) override {
+            bytes += chunk.size();
+            return true;
+          }
+          void onComplete(rest::Responder responder) override {
+            auto res = std::make_unique<rest::Response>();
+            res->status_code = rest::ResponseCode::OK;
+            res->body = std::make_unique<std::string>(std::to_string(bytes));
+            responder.send(std::move(res));
+          }
+        };
+        return std::make_unique<Counter>();
+      });
+
+  // one million lines, produced while they are sent
+  server.addHandler(
+      rest::Request::Type::GET, "/export", [](rest::Request const&) {
+        struct Lines : rest::BodyProducer {
+          int line = 0;
+          bool produce(std::string& out) override {
+            for (int end = line + 1000; line < end; ++line) {
+              out.append("line ").append(std::to_string(line)).push_back('\n');
+            }
+            return line < 1000000;
+          }
+        };
+        auto res = std::make_unique<rest::Response>();
+        res->status_code = rest::ResponseCode::OK;
+        res->producer = std::make_unique<Lines>();
+        return res;
+      });
+
+  // files of the working directory
+  server.addStaticFiles("/files", ".");
+
   server.listenAndServe();
 }
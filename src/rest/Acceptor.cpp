@@ -4,21 +4,71 @@
 
 #include "Acceptor.h"
 #include "Connection.h"
+#include "Logger.h"
 #include "Server.h"
 
 #include <chrono>
-#include <iostream>
 
 using namespace asiodemo::rest;
 
+namespace {
+#ifdef SO_REUSEPORT
+typedef asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>
+    reuse_port;
+#endif
+}  // namespace
+
+void Acceptor::recordWakeup(size_t accepted) {
+  _stats.wakeups.fetch_add(1, std::memory_order_relaxed);
+  _stats.accepted.fetch_add(accepted, std::memory_order_relaxed);
+  if (accepted > _stats.maxBatch.load(std::memory_order_relaxed)) {
+    _stats.maxBatch.store(accepted, std::memory_order_relaxed);
+  }
+}
+
+void Acceptor::recordHandshake(
+    std::chrono::steady_clock::time_point accepted) {
+  uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - accepted)
+                        .count();
+  _stats.handshakes.fetch_add(1, std::memory_order_relaxed);
+  _stats.handshakeMicros.fetch_add(micros, std::memory_order_relaxed);
+  uint64_t max = _stats.maxHandshakeMicros.load(std::memory_order_relaxed);
+  while (micros > max && !_stats.maxHandshakeMicros.compare_exchange_weak(
+                             max, micros, std::memory_order_relaxed)) {
+  }
+}
+
+void Acceptor::handleError(asio::error_code const& ec) {
+  if (ec == asio::error::operation_aborted) {
+    // this "error" is accpepted, so it doesn't justify a warning
+    LOG_DEBUG("accept failed: ", ec.message());
+    return;
+  }
+
+  if (++_acceptFailures <= maxAcceptErrors) {
+    LOG_WARN("accept failed: ", ec.message());
+    if (_acceptFailures == maxAcceptErrors) {
+      LOG_WARN("too many accept failures, stopping to report");
+    }
+  }
+  asyncAccept();  // retry
+}
+
 template <SocketType T>
-AcceptorTcp<T>::AcceptorTcp(asio::io_context& ctx, rest::Server& server,
-                            int port)
-    : Acceptor(server), _ctx(ctx), _acceptor(ctx), _asioSocket(), _port(port) {}
+AcceptorTcp<T>::AcceptorTcp(IoContext& ctx, rest::Server& server, int port,
+                            int shard)
+    : Acceptor(ctx, server),
+      _acceptor(ctx.io_context),
+      _asioSocket(),
+      _port(port),
+      _shard(shard),
+      _reusePort(server.options().reusePort),
+      _batchAccept(server.options().batchAccept) {}
 
 template <SocketType T>
 void AcceptorTcp<T>::open() {
-  asio::ip::tcp::resolver resolver(_ctx);
+  asio::ip::tcp::resolver resolver(_ctx.io_context);
 
   std::string hostname = "0.0.0.0";
 
@@ -42,18 +92,50 @@ void AcceptorTcp<T>::open() {
 
     asio::ip::tcp::resolver::iterator iter = resolver.resolve(*query, ec);
     if (ec) {
-      std::cout << "unable to to resolve endpoint ' " << hostname << ":"
-                << _port << "': " << ec.message();
+      LOG_ERROR("unable to to resolve endpoint ' ", hostname, ":", _port,
+                "': ", ec.message());
       throw std::runtime_error(ec.message());
     }
 
     if (asio::ip::tcp::resolver::iterator{} == iter) {
-      std::cout
-          << "unable to to resolve endpoint: endpoint is default constructed";
+      LOG_ERROR(
+          "unable to to resolve endpoint: endpoint is default constructed");
     }
 
     asioEndpoint = iter->endpoint();  // function not documented in boost?!
   }
+
+  int inherited = _server.takeInheritedListener(listenName());
+  if (inherited >= 0) {
+    // the previous process keeps accepting on it until it drains
+    _acceptor.assign(asioEndpoint.protocol(), inherited, ec);
+    if (ec) {
+      LOG_ERROR("unable to use the inherited socket for port ", _port, ": ",
+                ec.message());
+      throw std::runtime_error(ec.message());
+    }
+  } else {
+    bindAndListen(asioEndpoint, hostname);
+  }
+  if (_batchAccept) {
+    _acceptor.non_blocking(true, ec);
+    if (ec) {
+      LOG_WARN("unable to make acceptor non-blocking: ", ec.message());
+      _batchAccept = false;
+    }
+  }
+  _open = true;
+
+  LOG_INFO("successfully opened acceptor TCP on port ", _port,
+           inherited >= 0 ? " (inherited)" : "");
+
+  asyncAccept();
+}
+
+template <SocketType T>
+void AcceptorTcp<T>::bindAndListen(asio::ip::tcp::endpoint const& asioEndpoint,
+                                   std::string const& hostname) {
+  asio::error_code ec;
   _acceptor.open(asioEndpoint.protocol());
 
 #ifdef _WIN32
@@ -65,38 +147,45 @@ void AcceptorTcp<T>::open() {
 
   if (::setsockopt(_acceptor.native_handle(), SOL_SOCKET, SO_EXCLUSIVEADDRUSE,
                    (char const*)&trueOption, sizeof(BOOL)) != 0) {
-    std::cout << "unable to set acceptor socket option: " << WSAGetLastError();
+    LOG_ERROR("unable to set acceptor socket option: ", WSAGetLastError());
     THROW_ARANGO_EXCEPTION_MESSAGE(TRI_ERROR_FAILED,
                                    "unable to set acceptor socket option");
   }
 #else
   _acceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+  if (_reusePort) {
+#ifdef SO_REUSEPORT
+    _acceptor.set_option(reuse_port(true), ec);
+#else
+    ec = asio::error::operation_not_supported;
+#endif
+    if (ec) {
+      LOG_ERROR("unable to set SO_REUSEPORT on endpoint '", hostname, ":",
+                _port, "': ", ec.message());
+      throw std::runtime_error(ec.message());
+    }
+  }
 #endif
 
   _acceptor.bind(asioEndpoint, ec);
   if (ec) {
-    std::cout << "unable to to bind to endpoint ' " << hostname << ":" << _port
-              << "': " << ec.message();
+    LOG_ERROR("unable to to bind to endpoint ' ", hostname, ":", _port, "': ",
+              ec.message());
     throw std::runtime_error(ec.message());
   }
 
-  _acceptor.listen(8, ec);
+  _acceptor.listen(_server.options().listenBacklog, ec);
   if (ec) {
-    std::cout << "unable to listen to endpoint '" << hostname << ":" << _port
-              << ": " << ec.message();
+    LOG_ERROR("unable to listen to endpoint '", hostname, ":", _port, ": ",
+              ec.message());
     throw std::runtime_error(ec.message());
   }
-  _open = true;
-
-  std::cout << "successfully opened acceptor TCP";
-
-  asyncAccept();
 }
 
 template <SocketType T>
 void AcceptorTcp<T>::close() {
   if (_asioSocket) {
-    _asioSocket->timer.cancel();
+    _asioSocket->timeout.cancel();
   }
   if (_open) {
     _acceptor.close();
@@ -108,84 +197,151 @@ void AcceptorTcp<T>::close() {
   _open = false;
 }
 
-template <>
-void AcceptorTcp<SocketType::Tcp>::asyncAccept() {
-  assert(!_asioSocket);
-
-  // one could choose another IO context here to scale up
-  // auto& ctx = ::selectIoContext();
-  _asioSocket.reset(new AsioSocket<SocketType::Tcp>(_ctx));
-  auto handler = [this](asio::error_code const& ec) {
-    if (ec) {
-      handleError(ec);
-      return;
-    }
-
-    std::unique_ptr<AsioSocket<SocketType::Tcp>> as = std::move(_asioSocket);
-    auto conn =
-        std::make_shared<Connection<SocketType::Tcp>>(_server, std::move(as));
-    conn->start();
+template <SocketType T>
+IoContext& AcceptorTcp<T>::selectIoContext() {
+  if (_reusePort) {
+    return _ctx;  // the kernel already balanced the connections
+  }
+  return _server.selectIoContext();
+}
 
-    // accept next request
-    this->asyncAccept();
-  };
+template <>
+std::unique_ptr<AsioSocket<SocketType::Tcp>>
+AcceptorTcp<SocketType::Tcp>::newSocket(IoContext& ctx) {
+  return std::make_unique<AsioSocket<SocketType::Tcp>>(ctx);
+}
 
-  _acceptor.async_accept(_asioSocket->socket, _asioSocket->peer,
-                         std::move(handler));
+template <>
+std::unique_ptr<AsioSocket<SocketType::Ssl>>
+AcceptorTcp<SocketType::Ssl>::newSocket(IoContext& ctx) {
+  return std::make_unique<AsioSocket<SocketType::Ssl>>(ctx,
+                                                       _server.sslContext());
 }
 
 template <>
 void AcceptorTcp<SocketType::Tcp>::performHandshake(
-    std::unique_ptr<AsioSocket<SocketType::Tcp>> proto) {
+    std::unique_ptr<AsioSocket<SocketType::Tcp>>, IoContext&,
+    std::chrono::steady_clock::time_point) {
   assert(false);  // MSVC requires the implementation to exist
 }
 
 template <>
 void AcceptorTcp<SocketType::Ssl>::performHandshake(
-    std::unique_ptr<AsioSocket<SocketType::Ssl>> proto) {
-  // io_context is single-threaded, no sync needed
+    std::unique_ptr<AsioSocket<SocketType::Ssl>> proto, IoContext& runner,
+    std::chrono::steady_clock::time_point accepted) {
+  // every step of the handshake runs on the single thread of `runner`,
+  // the socket itself stays registered with its own context
   auto* ptr = proto.get();
-  proto->timer.expires_from_now(std::chrono::seconds(60));
-  proto->timer.async_wait([ptr](asio::error_code const& ec) {
-    if (ec) {  // canceled
-      return;
-    }
+  proto->timeout.callback = [ptr]() {
+    LOG_DEBUG("TLS handshake timeout");
     asio::error_code err;
     ptr->shutdown(err);  // ignore error
-  });
+  };
+  runner.timers.schedule(proto->timeout, std::chrono::seconds(60));
 
-  auto cb = [this, as = std::move(proto)](asio::error_code const& ec) mutable {
-    as->timer.cancel();
+  auto cb = [this, &runner, accepted,
+             as = std::move(proto)](asio::error_code const& ec) mutable {
+    as->timeout.cancel();
+    if (&runner != &as->context) {
+      runner.decClients();  // one pending handshake less
+    }
     if (ec) {
-      std::cout << "error during TLS handshake: '" << ec.message() << "'";
+      LOG_DEBUG("error during TLS handshake: '", ec.message(), "'");
       asio::error_code err;
       as->shutdown(err);  // ignore error
       return;
     }
+    recordHandshake(accepted);
+    if (TlsSessionCache* sessions = _server.tlsSessions()) {
+      sessions->recordHandshake(as->socket.native_handle());
+    }
+    if (_server.options().kernelTls &&
+        ktls::enableSend(as->socket.native_handle(),
+                         as->socket.lowest_layer().native_handle())) {
+      as->kernelSend = true;
+      _stats.kernelTls.fetch_add(1, std::memory_order_relaxed);
+    }
 
+    IoContext& ctx = as->context;
     auto conn =
         std::make_shared<Connection<SocketType::Ssl>>(_server, std::move(as));
-    conn->start();
+    if (&ctx == &runner) {
+      conn->start();
+    } else {
+      // hand the established connection back to its own context
+      asio::post(ctx.io_context, [conn]() { conn->start(); });
+    }
   };
-  ptr->handshake(std::move(cb));
+  ptr->handshake(asio::bind_executor(runner.io_context, std::move(cb)));
+}
+
+template <>
+void AcceptorTcp<SocketType::Tcp>::startConnection(
+    std::unique_ptr<AsioSocket<SocketType::Tcp>> as) {
+  IoContext& ctx = as->context;
+  auto conn =
+      std::make_shared<Connection<SocketType::Tcp>>(_server, std::move(as));
+  if (&ctx == &_ctx) {
+    conn->start();
+  } else {
+    // the connection must only be used by the thread of its own context
+    asio::post(ctx.io_context, [conn]() { conn->start(); });
+  }
 }
 
 template <>
-void AcceptorTcp<SocketType::Ssl>::asyncAccept() {
-  assert(!_asioSocket);
+void AcceptorTcp<SocketType::Ssl>::startConnection(
+    std::unique_ptr<AsioSocket<SocketType::Ssl>> as) {
+  auto accepted = std::chrono::steady_clock::now();
+  IoContext* runner = _server.selectHandshakeContext();
+  if (runner != nullptr) {
+    // the handshake contexts only count pending handshakes as clients
+    runner->incClients();
+    uint64_t queued =
+        _stats.handshakesQueued.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (queued > _stats.maxHandshakesQueued.load(std::memory_order_relaxed)) {
+      _stats.maxHandshakesQueued.store(queued, std::memory_order_relaxed);
+    }
+    asio::post(runner->io_context,
+               [this, runner, accepted, as = std::move(as)]() mutable {
+                 _stats.handshakesQueued.fetch_sub(1,
+                                                   std::memory_order_relaxed);
+                 performHandshake(std::move(as), *runner, accepted);
+               });
+  } else if (&as->context == &_ctx) {
+    performHandshake(std::move(as), _ctx, accepted);
+  } else {
+    // run the handshake on the context the socket is bound to
+    asio::io_context& ioContext = as->context.io_context;
+    asio::post(ioContext, [this, accepted, as = std::move(as)]() mutable {
+      IoContext& ctx = as->context;
+      performHandshake(std::move(as), ctx, accepted);
+    });
+  }
+}
 
-  // select the io context for this socket
-  auto& ctx = _ctx;  // _server.selectIoContext();
+template <SocketType T>
+void AcceptorTcp<T>::asyncAccept() {
+  // a socket left over from a failed or drained accept is reused
+  if (!_asioSocket) {
+    // select the io context for this socket
+    _asioSocket = newSocket(selectIoContext());
+  }
 
-  _asioSocket =
-      std::make_unique<AsioSocket<SocketType::Ssl>>(ctx, _server.sslContext());
   auto handler = [this](asio::error_code const& ec) {
     if (ec) {
       handleError(ec);
       return;
     }
 
-    performHandshake(std::move(_asioSocket));
+    startConnection(std::move(_asioSocket));
+    size_t accepted = 1;
+    if (_batchAccept) {
+      accepted += acceptPending();
+    }
+    recordWakeup(accepted);
+
+    // accept next request
     this->asyncAccept();
   };
 
@@ -194,21 +350,27 @@ void AcceptorTcp<SocketType::Ssl>::asyncAccept() {
 }
 
 template <SocketType T>
-void AcceptorTcp<T>::handleError(asio::error_code const& ec) {
-  if (ec == asio::error::operation_aborted) {
-    // this "error" is accpepted, so it doesn't justify a warning
-    std::cout << "accept failed: " << ec.message();
-    return;
-  }
-
-  if (++_acceptFailures <= maxAcceptErrors) {
-    std::cout << "accept failed: " << ec.message();
-    if (_acceptFailures == maxAcceptErrors) {
-      std::cout << "too many accept failures, stopping to report";
+size_t AcceptorTcp<T>::acceptPending() {
+  // the listening socket is non-blocking, take everything the kernel
+  // has queued before going back to the reactor
+  size_t accepted = 0;
+  while (_open) {
+    if (!_asioSocket) {
+      _asioSocket = newSocket(selectIoContext());
     }
+    asio::error_code ec;
+    _acceptor.accept(_asioSocket->socket.lowest_layer(), _asioSocket->peer,
+                     ec);
+    if (ec) {
+      if (ec != asio::error::would_block && ec != asio::error::try_again) {
+        LOG_WARN("accept failed: ", ec.message());
+      }
+      break;
+    }
+    startConnection(std::move(_asioSocket));
+    ++accepted;
   }
-  asyncAccept();  // retry
-  return;
+  return accepted;
 }
 
 template class asiodemo::rest::AcceptorTcp<SocketType::Tcp>;
@@ -7,53 +7,180 @@
 
 #include "AsioSocket.h"
 
+#include <atomic>
+#include <chrono>
+#include <string>
+
 namespace asiodemo { namespace rest {
 
 class Server;
 
 class Acceptor {
+ public:
+  struct Stats {
+    /// completions of async_accept
+    std::atomic<uint64_t> wakeups{0};
+    /// connections accepted in total
+    std::atomic<uint64_t> accepted{0};
+    /// most connections accepted in a single wakeup
+    std::atomic<uint64_t> maxBatch{0};
+
+    /// TLS handshakes waiting for their thread (see
+    /// ServerOptions::handshakeThreads) and the most at once
+    std::atomic<uint64_t> handshakesQueued{0};
+    std::atomic<uint64_t> maxHandshakesQueued{0};
+    /// completed TLS handshakes and their time from accept to completion
+    std::atomic<uint64_t> handshakes{0};
+    std::atomic<uint64_t> handshakeMicros{0};
+    std::atomic<uint64_t> maxHandshakeMicros{0};
+    /// TLS connections sending with kTLS (see ServerOptions::kernelTls)
+    std::atomic<uint64_t> kernelTls{0};
+  };
+
  public:
   virtual ~Acceptor() {}
 
   virtual void open() = 0;
   virtual void close() = 0;
 
+  /// identifies the listening socket across a binary upgrade, e.g.
+  /// "tcp:80" or "tcp:80#1" for a SO_REUSEPORT shard (see SocketHandoff)
+  virtual std::string listenName() const = 0;
+  /// descriptor of the listening socket
+  virtual int nativeHandle() = 0;
+  /// the listening socket lives on in the process replacing this one,
+  /// close() must not remove it
+  void handOver() { _handedOver = true; }
+
   /// start accepting connections
   virtual void asyncAccept() = 0;
 
+  /// runs open(), close() and the accept loop
+  IoContext& context() const { return _ctx; }
+
+  Stats const& stats() const { return _stats; }
+
+  /// average number of connections accepted per wakeup
+  double acceptedPerWakeup() const {
+    uint64_t wakeups = _stats.wakeups.load(std::memory_order_relaxed);
+    return wakeups == 0
+               ? 0.0
+               : double(_stats.accepted.load(std::memory_order_relaxed)) /
+                     double(wakeups);
+  }
+
  protected:
-  Acceptor(rest::Server& server)
-      : _open(false), _acceptFailures(0), _server(server) {}
+  Acceptor(IoContext& ctx, rest::Server& server)
+      : _ctx(ctx),
+        _open(false),
+        _handedOver(false),
+        _acceptFailures(0),
+        _server(server) {}
+
+  /// count a wakeup which accepted `accepted` connections
+  void recordWakeup(size_t accepted);
+  /// count a completed TLS handshake of a connection accepted at `accepted`
+  void recordHandshake(std::chrono::steady_clock::time_point accepted);
+  /// log (rate limited) and accept again
+  void handleError(asio::error_code const&);
+  static constexpr int maxAcceptErrors = 128;
 
  protected:
+  /// context running the acceptor, sockets are bound to
+  /// the context chosen by Server::selectIoContext()
+  IoContext& _ctx;
   bool _open;
+  bool _handedOver;
   size_t _acceptFailures;
   rest::Server& _server;
+  Stats _stats;
 };
 
 template <SocketType T>
 class AcceptorTcp : public Acceptor {
  public:
-  AcceptorTcp(asio::io_context& ctx, rest::Server& server, int port);
+  /// `shard` numbers the acceptors sharing the port with SO_REUSEPORT,
+  /// -1 without
+  AcceptorTcp(IoContext& ctx, rest::Server& server, int port,
+              int shard = -1);
 
  public:
   void open() override;
   void close() override;
   void asyncAccept() override;
+  std::string listenName() const override {
+    return listenName(_port, _shard);
+  }
+  /// e.g. "tcp:443" or "tcp:443#2" for the third shard
+  static std::string listenName(int port, int shard) {
+    std::string name = "tcp:" + std::to_string(port);
+    return shard < 0 ? name : name + "#" + std::to_string(shard);
+  }
+  int nativeHandle() override { return _acceptor.native_handle(); }
 
  private:
-  void performHandshake(std::unique_ptr<AsioSocket<T>>);
-
-  void handleError(asio::error_code const&);
-  static constexpr int maxAcceptErrors = 128;
+  /// open a new listening socket
+  void bindAndListen(asio::ip::tcp::endpoint const& endpoint,
+                     std::string const& hostname);
+  std::unique_ptr<AsioSocket<T>> newSocket(IoContext&);
+  /// hand an accepted socket to its connection (or TLS handshake)
+  void startConnection(std::unique_ptr<AsioSocket<T>>);
+  /// TLS handshake on the thread of `runner`, the socket stays
+  /// registered with its own context
+  void performHandshake(std::unique_ptr<AsioSocket<T>>, IoContext& runner,
+                        std::chrono::steady_clock::time_point accepted);
+
+  /// synchronously accept all pending connections, returns their number
+  size_t acceptPending();
+
+  /// context for a newly accepted socket
+  IoContext& selectIoContext();
 
  private:
-  asio::io_context& _ctx;
   asio::ip::tcp::acceptor _acceptor;
   std::unique_ptr<AsioSocket<T>> _asioSocket;
   int _port;
+  int _shard;
+  /// one acceptor per io context sharing the port via SO_REUSEPORT,
+  /// accepted sockets then stay on the acceptor's context
+  bool _reusePort;
+  /// drain the accept queue on every wakeup
+  bool _batchAccept;
 };
 
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+/// Accepts connections on a unix domain socket, local clients (e.g. a
+/// sidecar proxy) skip the TCP/IP stack. A stale socket file nobody
+/// listens on is replaced, any other existing path is left alone.
+/// Accepted sockets are spread with Server::selectIoContext()
+class AcceptorUnix : public Acceptor {
+ public:
+  AcceptorUnix(IoContext& ctx, rest::Server& server, std::string path);
+  /// removes the socket file
+  ~AcceptorUnix() { close(); }
+
+ public:
+  void open() override;
+  void close() override;
+  void asyncAccept() override;
+  std::string listenName() const override { return "unix:" + _path; }
+  int nativeHandle() override { return _acceptor.native_handle(); }
+
+ private:
+  /// open a new listening socket, replacing a stale socket file
+  void bindAndListen(asio::local::stream_protocol::endpoint const& endpoint);
+  void startConnection(std::unique_ptr<AsioSocket<SocketType::Unix>>);
+  /// synchronously accept all pending connections, returns their number
+  size_t acceptPending();
+
+ private:
+  asio::local::stream_protocol::acceptor _acceptor;
+  std::unique_ptr<AsioSocket<SocketType::Unix>> _asioSocket;
+  std::string const _path;
+  bool _batchAccept;
+};
+#endif
+
 }}  // namespace asiodemo::rest
 
 #endif
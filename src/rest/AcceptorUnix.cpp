@@ -0,0 +1,181 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Acceptor.h"
+#include "Connection.h"
+#include "Logger.h"
+#include "Server.h"
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace asiodemo::rest;
+
+AcceptorUnix::AcceptorUnix(IoContext& ctx, rest::Server& server,
+                           std::string path)
+    : Acceptor(ctx, server),
+      _acceptor(ctx.io_context),
+      _asioSocket(),
+      _path(std::move(path)),
+      _batchAccept(server.options().batchAccept) {}
+
+void AcceptorUnix::open() {
+  asio::local::stream_protocol::endpoint endpoint(_path);
+  asio::error_code ec;
+  int inherited = _server.takeInheritedListener(listenName());
+  if (inherited >= 0) {
+    // bound to the socket file of the previous process
+    _acceptor.assign(endpoint.protocol(), inherited, ec);
+    if (ec) {
+      LOG_ERROR("unable to use the inherited unix socket '", _path, "': ",
+                ec.message());
+      throw std::runtime_error(ec.message());
+    }
+  } else {
+    bindAndListen(endpoint);
+  }
+  if (_batchAccept) {
+    _acceptor.non_blocking(true, ec);
+    if (ec) {
+      LOG_WARN("unable to make acceptor non-blocking: ", ec.message());
+      _batchAccept = false;
+    }
+  }
+  _open = true;
+
+  LOG_INFO("successfully opened acceptor on unix socket '", _path, "'",
+           inherited >= 0 ? " (inherited)" : "");
+
+  asyncAccept();
+}
+
+void AcceptorUnix::bindAndListen(
+    asio::local::stream_protocol::endpoint const& endpoint) {
+  asio::error_code ec;
+  struct stat st;
+  if (::lstat(_path.c_str(), &st) == 0) {
+    // a previous process may have left the socket file behind, bind()
+    // would fail. It is only removed if nobody listens on it anymore,
+    // neither other files nor the socket of a running server are touched
+    if (S_ISSOCK(st.st_mode)) {
+      asio::local::stream_protocol::socket probe(_ctx.io_context);
+      probe.open(endpoint.protocol(), ec);
+      if (!ec) {
+        probe.non_blocking(true, ec);  // a full backlog must not block
+      }
+      if (!ec) {
+        probe.connect(endpoint, ec);
+      }
+    }
+    if (!S_ISSOCK(st.st_mode) || ec != asio::error::connection_refused) {
+      ec = asio::error::address_in_use;
+      LOG_ERROR("unable to bind to unix socket '", _path, "': ",
+                ec.message());
+      throw std::runtime_error(ec.message());
+    }
+    if (::unlink(_path.c_str()) == 0) {
+      LOG_INFO("removed stale unix socket '", _path, "'");
+    }
+    ec.clear();
+  }
+
+  _acceptor.open(endpoint.protocol(), ec);
+  if (!ec) {
+    _acceptor.bind(endpoint, ec);
+  }
+  if (ec) {
+    LOG_ERROR("unable to bind to unix socket '", _path, "': ", ec.message());
+    throw std::runtime_error(ec.message());
+  }
+
+  _acceptor.listen(_server.options().listenBacklog, ec);
+  if (ec) {
+    LOG_ERROR("unable to listen to unix socket '", _path, "': ",
+              ec.message());
+    throw std::runtime_error(ec.message());
+  }
+}
+
+void AcceptorUnix::close() {
+  if (_asioSocket) {
+    _asioSocket->timeout.cancel();
+  }
+  if (_open) {
+    _acceptor.close();
+    if (_asioSocket) {
+      asio::error_code ec;
+      _asioSocket->shutdown(ec);
+    }
+    if (!_handedOver) {
+      ::unlink(_path.c_str());
+    }
+  }
+  _open = false;
+}
+
+void AcceptorUnix::startConnection(
+    std::unique_ptr<AsioSocket<SocketType::Unix>> as) {
+  IoContext& ctx = as->context;
+  auto conn =
+      std::make_shared<Connection<SocketType::Unix>>(_server, std::move(as));
+  if (&ctx == &_ctx) {
+    conn->start();
+  } else {
+    // the connection must only be used by the thread of its own context
+    asio::post(ctx.io_context, [conn]() { conn->start(); });
+  }
+}
+
+void AcceptorUnix::asyncAccept() {
+  // a socket left over from a failed or drained accept is reused
+  if (!_asioSocket) {
+    _asioSocket = std::make_unique<AsioSocket<SocketType::Unix>>(
+        _server.selectIoContext());
+  }
+
+  auto handler = [this](asio::error_code const& ec) {
+    if (ec) {
+      handleError(ec);
+      return;
+    }
+
+    startConnection(std::move(_asioSocket));
+    size_t accepted = 1;
+    if (_batchAccept) {
+      accepted += acceptPending();
+    }
+    recordWakeup(accepted);
+
+    // accept next request
+    this->asyncAccept();
+  };
+
+  _acceptor.async_accept(_asioSocket->socket, _asioSocket->peer,
+                         std::move(handler));
+}
+
+size_t AcceptorUnix::acceptPending() {
+  size_t accepted = 0;
+  while (_open) {
+    if (!_asioSocket) {
+      _asioSocket = std::make_unique<AsioSocket<SocketType::Unix>>(
+          _server.selectIoContext());
+    }
+    asio::error_code ec;
+    _acceptor.accept(_asioSocket->socket, _asioSocket->peer, ec);
+    if (ec) {
+      if (ec != asio::error::would_block && ec != asio::error::try_again) {
+        LOG_WARN("accept failed: ", ec.message());
+      }
+      break;
+    }
+    startConnection(std::move(_asioSocket));
+    ++accepted;
+  }
+  return accepted;
+}
+
+#endif
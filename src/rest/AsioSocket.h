@@ -14,6 +14,10 @@
 #include <asio.hpp>
 #include <asio/ssl.hpp>
 
+#include "IoContext.h"
+#include "KernelTls.h"
+#include "ReadBuffer.h"
+
 namespace asiodemo { namespace rest {
 
 enum class SocketType { Tcp = 1, Ssl = 2, Unix = 3 };
@@ -25,15 +29,19 @@ struct AsioSocket {};
 
 template <>
 struct AsioSocket<SocketType::Tcp> {
-  AsioSocket(asio::io_context& ctx) : context(ctx), socket(ctx), timer(ctx) {}
+  AsioSocket(IoContext& ctx)
+      : context(ctx), socket(ctx.io_context) {
+    context.incClients();
+  }
 
   ~AsioSocket() {
-    timer.cancel();
+    timeout.cancel();
     try {
       asio::error_code ec;
       shutdown(ec);
     } catch (...) {
     }
+    context.decClients();
   }
 
   void setNonBlocking(bool v) { socket.non_blocking(v); }
@@ -57,31 +65,44 @@ struct AsioSocket<SocketType::Tcp> {
     }
   }
 
-  asio::io_context& context;
+  IoContext& context;
   asio::ip::tcp::socket socket;
   asio::ip::tcp::acceptor::endpoint_type peer;
-  asio::steady_timer timer;
-  asio::streambuf buffer;
+  /// keep-alive / header-read deadline on context.timers
+  TimerWheel::Entry timeout;
+  ReadBuffer buffer;
 };
 
 template <>
 struct AsioSocket<SocketType::Ssl> {
-  AsioSocket(asio::io_context& ctx, asio::ssl::context& sslContext)
-      : context(ctx), socket(ctx, sslContext), timer(ctx) {}
+  AsioSocket(IoContext& ctx, asio::ssl::context& sslContext)
+      : context(ctx),
+        socket(ctx.io_context, sslContext) {
+    context.incClients();
+  }
 
   ~AsioSocket() {
+    timeout.cancel();
     try {
-      timer.cancel();
       asio::error_code ec;
       shutdown(ec);
     } catch (...) {
     }
+    context.decClients();
   }
 
   void setNonBlocking(bool v) { socket.lowest_layer().non_blocking(v); }
-  bool supportsMixedIO() const { return false; }
+  bool supportsMixedIO() const { return true; }
+  /// decrypted bytes buffered by OpenSSL, records handed to OpenSSL but
+  /// not yet processed and the encrypted bytes in the kernel. Bytes asio
+  /// read but could not hand to OpenSSL yet are missing, the next
+  /// read_some() or async_read_some() uses them first
   std::size_t available(asio::error_code& ec) const {
-    return 0;  // always disable
+    SSL* ssl = const_cast<asio::ssl::stream<asio::ip::tcp::socket>&>(socket)
+                   .native_handle();
+    std::size_t buffered = static_cast<std::size_t>(SSL_pending(ssl)) +
+                           BIO_ctrl_pending(SSL_get_rbio(ssl));
+    return buffered + socket.lowest_layer().available(ec);
   }
 
   template <typename F>
@@ -96,7 +117,12 @@ struct AsioSocket<SocketType::Ssl> {
 #ifndef _WIN32
       socket.lowest_layer().cancel(ec);
 #endif
-      if (!ec) {
+      if (!ec && kernelSend) {
+        // OpenSSL's write state is outdated, the kernel sends the alert
+        ktls::sendCloseNotify(socket.lowest_layer().native_handle());
+        socket.lowest_layer().shutdown(asio::ip::tcp::socket::shutdown_both,
+                                       ec);
+      } else if (!ec) {
         socket.shutdown(ec);
       }
 #ifndef _WIN32
@@ -108,12 +134,62 @@ struct AsioSocket<SocketType::Ssl> {
     }
   }
 
-  asio::io_context& context;
+  IoContext& context;
   asio::ssl::stream<asio::ip::tcp::socket> socket;
   asio::ip::tcp::acceptor::endpoint_type peer;
-  asio::steady_timer timer;
-  asio::streambuf buffer;
+  /// handshake / keep-alive / header-read deadline on context.timers
+  TimerWheel::Entry timeout;
+  ReadBuffer buffer;
+  /// the kernel encrypts outgoing records (kTLS), writes bypass OpenSSL
+  /// and go to socket.next_layer()
+  bool kernelSend = false;
+};
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+template <>
+struct AsioSocket<SocketType::Unix> {
+  AsioSocket(IoContext& ctx) : context(ctx), socket(ctx.io_context) {
+    context.incClients();
+  }
+
+  ~AsioSocket() {
+    timeout.cancel();
+    try {
+      asio::error_code ec;
+      shutdown(ec);
+    } catch (...) {
+    }
+    context.decClients();
+  }
+
+  void setNonBlocking(bool v) { socket.non_blocking(v); }
+  bool supportsMixedIO() const { return true; }
+  std::size_t available(asio::error_code& ec) const {
+    return socket.available(ec);
+  }
+
+  void shutdown(asio::error_code& ec) {
+    if (socket.is_open()) {
+      socket.cancel(ec);
+      if (!ec) {
+        socket.shutdown(asio::local::stream_protocol::socket::shutdown_both,
+                        ec);
+      }
+      if (!ec || ec == asio::error::basic_errors::not_connected) {
+        ec.clear();
+        socket.close(ec);
+      }
+    }
+  }
+
+  IoContext& context;
+  asio::local::stream_protocol::socket socket;
+  asio::local::stream_protocol::acceptor::endpoint_type peer;
+  /// keep-alive / header-read deadline on context.timers
+  TimerWheel::Entry timeout;
+  ReadBuffer buffer;
 };
+#endif
 
 }}  // namespace asiodemo::rest
 #endif
@@ -0,0 +1,56 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "CommonHeaders.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+using namespace asiodemo::rest;
+
+namespace {
+constexpr std::string_view DatePrefix = "Date: ";
+constexpr char const* Days[] = {"Sun", "Mon", "Tue", "Wed",
+                                "Thu", "Fri", "Sat"};
+constexpr char const* Months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+constexpr std::string_view Tail =
+    "\r\nConnection: Keep-Alive\r\nKeep-Alive: timeout=60\r\n\r\n";
+constexpr std::string_view CloseTail = "\r\nConnection: close\r\n\r\n";
+}  // namespace
+
+void CommonHeaders::tick() {
+  Cache& cache = threadCache();
+  cache.timerDriven = true;
+  cache.format(std::time(nullptr));
+}
+
+void CommonHeaders::Cache::format(std::time_t now) {
+  std::tm tm;
+  gmtime_r(&now, &tm);
+
+  char* p = data;
+  std::memcpy(p, ContentTypeLine.data(), ContentTypeLine.size());
+  p += ContentTypeLine.size();
+  std::memcpy(p, DatePrefix.data(), DatePrefix.size());
+  p += DatePrefix.size();
+  // IMF-fixdate (RFC 7231 section 7.1.1.1), not strftime: it is locale
+  // dependent
+  int n = std::snprintf(p, data + Capacity - p,
+                        "%s, %02d %s %04d %02d:%02d:%02d GMT", Days[tm.tm_wday],
+                        tm.tm_mday, Months[tm.tm_mon], tm.tm_year + 1900,
+                        tm.tm_hour, tm.tm_min, tm.tm_sec);
+  assert(n == 29);
+  p += n;
+  size_t prefix = p - data;
+  assert(Capacity - prefix >= Tail.size());
+  std::memcpy(p, Tail.data(), Tail.size());
+  size = prefix + Tail.size();
+
+  std::memcpy(closing, data, prefix);
+  std::memcpy(closing + prefix, CloseTail.data(), CloseTail.size());
+  closingSize = prefix + CloseTail.size();
+  second = now;
+}
@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef COMMON_HEADERS_H
+#define COMMON_HEADERS_H 1
+
+#include <ctime>
+#include <string_view>
+
+namespace asiodemo { namespace rest {
+
+/// Per-thread preformatted block of the headers every response carries:
+///
+///   Content-Type: text/plain; charset=utf-8\r\n
+///   Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n
+///   Connection: Keep-Alive\r\n
+///   Keep-Alive: timeout=60\r\n
+///   \r\n
+///
+/// A second variant ends the connection, it carries "Connection: close"
+/// instead of the keep-alive lines.
+/// The io threads refresh their copy once a second from a timer (see
+/// IoContext), any other thread refreshes lazily when the second changed.
+class CommonHeaders {
+ public:
+  /// the complete block, terminates the header
+  static std::string_view block(bool keepAlive = true) {
+    return current().view(keepAlive);
+  }
+  /// the block without the leading Content-Type line
+  static std::string_view blockWithoutContentType(bool keepAlive = true) {
+    return block(keepAlive).substr(ContentTypeLine.size());
+  }
+
+  /// reformat the Date header of the calling thread, called by the
+  /// io threads every second. Later calls to block() on this thread
+  /// do not check the clock anymore.
+  static void tick();
+
+ private:
+  static constexpr std::string_view ContentTypeLine =
+      "Content-Type: text/plain; charset=utf-8\r\n";
+  static constexpr size_t Capacity = 160;
+
+  struct Cache {
+    char data[Capacity];
+    size_t size = 0;
+    /// the "Connection: close" variant
+    char closing[Capacity];
+    size_t closingSize = 0;
+    std::time_t second = -1;
+    bool timerDriven = false;
+
+    std::string_view view(bool keepAlive) const {
+      return keepAlive ? std::string_view(data, size)
+                       : std::string_view(closing, closingSize);
+    }
+    void format(std::time_t now);
+  };
+
+  static Cache& current() {
+    Cache& cache = threadCache();
+    if (!cache.timerDriven) {
+      std::time_t now = std::time(nullptr);
+      if (now != cache.second) {
+        cache.format(now);
+      }
+    }
+    return cache;
+  }
+
+  static Cache& threadCache() {
+    thread_local Cache cache;
+    return cache;
+  }
+};
+
+}}  // namespace asiodemo::rest
+
+#endif
@@ -3,27 +3,46 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "Connection.h"
+#include "Logger.h"
 #include "Server.h"
+#include "StaticFiles.h"
 #include "Utils.h"
 
+#include <cerrno>
 #include <cstring>
-#include <iostream>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 
 using namespace asiodemo;
 using namespace asiodemo::rest;
 
 namespace {
 constexpr static size_t MaximalBodySize = 1024 * 1024 * 1024;  // 1024 MB
+/// idle time between two requests, see the Keep-Alive header
+constexpr std::chrono::seconds KeepAliveTimeout(60);
+/// time a client has to send the header of a request it started
+constexpr std::chrono::seconds HeaderTimeout(30);
+/// bytes of a file sent before the connection yields to the others
+constexpr uint64_t SendfileSlice = 16 * 1024 * 1024;
 
 }  // namespace
 
 template <SocketType T>
 int Connection<T>::on_message_began(llhttp_t* p) {
   Connection<T>* self = static_cast<Connection<T>*>(p->data);
-  self->_lastHeaderField.clear();
-  self->_lastHeaderValue.clear();
-  self->_origin.clear();
-  self->_request = std::make_unique<rest::Request>();
+  self->_url = Token();
+  self->_headerTokens.clear();
+  self->_origin = std::string_view();
+  self->_request->clear();
+  self->_bodyConsumer.reset();
+  self->_bodyOffset = 0;
+  self->_protocol->context.timers.schedule(self->_protocol->timeout,
+                                           HeaderTimeout);
+  // the message starts somewhere after this, on_url tells us exactly
+  self->_messageStart = self->_parsedBytes;
+  self->_pinned = true;
   self->_lastHeaderWasValue = false;
   self->_shouldKeepAlive = false;
   self->_denyCredentials = false;
@@ -34,7 +53,10 @@ int Connection<T>::on_message_began(llhttp_t* p) {
 template <SocketType T>
 int Connection<T>::on_url(llhttp_t* p, const char* at, size_t len) {
   Connection<T>* self = static_cast<Connection<T>*>(p->data);
-  self->_request->parseUrl(at, len);
+  if (self->_url.length == 0) {
+    self->_messageStart = at - self->_parseBase;
+  }
+  self->appendToken(self->_url, at, len);
   self->_request->method = utils::llhttpToRequestType(p);
   if (self->_request->method == Request::Type::ILLEGAL) {
     self->addSimpleResponse(rest::ResponseCode::METHOD_NOT_ALLOWED);
@@ -53,14 +75,12 @@ int Connection<T>::on_status(llhttp_t* p, const char* at, size_t len) {
 template <SocketType T>
 int Connection<T>::on_header_field(llhttp_t* p, const char* at, size_t len) {
   Connection<T>* self = static_cast<Connection<T>*>(p->data);
-  if (self->_lastHeaderWasValue) {
-    utils::tolowerInPlace(self->_lastHeaderField);
-    self->_request->setHeader(std::move(self->_lastHeaderField),
-                              std::move(self->_lastHeaderValue));
-    self->_lastHeaderField.assign(at, len);
-  } else {
-    self->_lastHeaderField.append(at, len);
+  if (self->_lastHeaderWasValue || self->_headerTokens.empty()) {
+    self->_headerTokens.emplace_back();
   }
+  // the buffer belongs to us, header names are lowered in place
+  utils::tolowerInPlace(const_cast<char*>(at), len);
+  self->appendToken(self->_headerTokens.back().first, at, len);
   self->_lastHeaderWasValue = false;
   return HPE_OK;
 }
@@ -68,11 +88,8 @@ int Connection<T>::on_header_field(llhttp_t* p, const char* at, size_t len) {
 template <SocketType T>
 int Connection<T>::on_header_value(llhttp_t* p, const char* at, size_t len) {
   Connection<T>* self = static_cast<Connection<T>*>(p->data);
-  if (self->_lastHeaderWasValue) {
-    self->_lastHeaderValue.append(at, len);
-  } else {
-    self->_lastHeaderValue.assign(at, len);
-  }
+  assert(!self->_headerTokens.empty());
+  self->appendToken(self->_headerTokens.back().second, at, len);
   self->_lastHeaderWasValue = true;
   return HPE_OK;
 }
@@ -80,40 +97,59 @@ int Connection<T>::on_header_value(llhttp_t* p, const char* at, size_t len) {
 template <SocketType T>
 int Connection<T>::on_header_complete(llhttp_t* p) {
   Connection<T>* self = static_cast<Connection<T>*>(p->data);
-  if (!self->_lastHeaderField.empty()) {
-    utils::tolowerInPlace(self->_lastHeaderField);
-    self->_request->setHeader(std::move(self->_lastHeaderField),
-                              std::move(self->_lastHeaderValue));
-  }
+  self->_protocol->timeout.cancel();
+  self->bindRequest();
 
   if ((p->http_major != 1 && p->http_minor != 0) &&
       (p->http_major != 1 && p->http_minor != 1)) {
     self->addSimpleResponse(rest::ResponseCode::HTTP_VERSION_NOT_SUPPORTED);
     return HPE_USER;
   }
-  if (p->content_length > MaximalBodySize) {
-    self->addSimpleResponse(rest::ResponseCode::REQUEST_ENTITY_TOO_LARGE);
-    return HPE_USER;
+
+  if (p->content_length > 0 || (p->flags & F_CHUNKED)) {
+    bool accepted;
+    self->_bodyConsumer =
+        self->_server.openBodyStream(*self->_request, *self, accepted);
+    if (!accepted) {
+      self->addSimpleResponse(rest::ResponseCode::SERVER_ERROR);
+      return HPE_USER;
+    }
   }
-  if (p->content_length > 0) {
-    // lets not reserve more than 64MB at once
-    uint64_t maxReserve = std::min<uint64_t>(2 << 26, p->content_length);
-    self->_request->body.reserve(maxReserve + 1);
+  // body bytes after the header are dropped once they are consumed or
+  // copied into the request, only the header tokens stay pinned
+  size_t end = self->_url.offset + self->_url.length;
+  for (auto const& it : self->_headerTokens) {
+    end = std::max(end, it.first.offset + it.first.length);
+    end = std::max(end, it.second.offset + it.second.length);
+  }
+  self->_bodyOffset = end;
+  if (!self->_bodyConsumer) {
+    if (p->content_length > MaximalBodySize) {
+      self->addSimpleResponse(rest::ResponseCode::REQUEST_ENTITY_TOO_LARGE);
+      return HPE_USER;
+    }
+    if (p->content_length > 0) {
+      // lets not reserve more than 64MB at once
+      uint64_t maxReserve = std::min<uint64_t>(2 << 26, p->content_length);
+      self->_request->body.reserve(maxReserve + 1);
+    }
   }
   self->_shouldKeepAlive = llhttp_should_keep_alive(p);
 
   bool found;
-  std::string const& expect = self->_request->header("expect", found);
+  std::string_view expect =
+      self->_request->header(KnownHeader::Expect, found);
   if (found && utils::trim(expect) == "100-continue") {
-    std::cout << "received a 100-continue request";
-    char const* response = "HTTP/1.1 100 Continue\r\n\r\n";
-    auto buff = asio::buffer(response, strlen(response));
-    asio::async_write(
-        self->_protocol->socket, buff,
-        [self](asio::error_code const& ec, std::size_t transferred) {
-          llhttp_resume(&self->_parser);
-          self->asyncReadSome();
-        });
+    LOG_DEBUG("received a 100-continue request");
+    // queued behind the responses to earlier pipelined requests, the
+    // parser resumes once it is written
+    std::string_view response = "HTTP/1.1 100 Continue\r\n\r\n";
+    size_t offset = self->_writeBuffer.size();
+    self->_writeBuffer.append(response.data(), response.size());
+    QueuedResponse queued;
+    queued.headerOffset = offset;
+    queued.headerLength = response.size();
+    self->_responses.push_back(std::move(queued));
     return HPE_PAUSED;
   }
   if (self->_request->method == Request::Type::HEAD) {
@@ -126,6 +162,16 @@ int Connection<T>::on_header_complete(llhttp_t* p) {
 template <SocketType T>
 int Connection<T>::on_body(llhttp_t* p, const char* at, size_t len) {
   Connection<T>* self = static_cast<Connection<T>*>(p->data);
+  if (self->_bodyConsumer) {
+    if (len == 0) {  // open span of a resumed parser
+      return HPE_OK;
+    }
+    if (!self->_bodyConsumer->onData(std::string_view(at, len))) {
+      self->_bodyPaused = true;  // BodyControl::resume() continues
+      return HPE_PAUSED;
+    }
+    return HPE_OK;
+  }
   self->_request->body.append(at, len);
   return HPE_OK;
 }
@@ -133,13 +179,72 @@ int Connection<T>::on_body(llhttp_t* p, const char* at, size_t len) {
 template <SocketType T>
 int Connection<T>::on_message_complete(llhttp_t* p) {
   Connection<T>* self = static_cast<Connection<T>*>(p->data);
+  // reading the body may have moved the receive buffer
+  self->bindRequest();
   self->processRequest();
+  // keep parsing pipelined requests, their responses are written together
+  // once the parser is done with the receive buffer
+  if (!self->_awaitingResponse && !self->_closeAfterFlush &&
+      self->_responses.size() < self->_server.options().maxPipelinedRequests) {
+    return HPE_OK;
+  }
   return HPE_PAUSED;
 }
 
+template <SocketType T>
+char* Connection<T>::bufferBegin() const {
+  return _protocol->buffer.data();
+}
+
+template <SocketType T>
+void Connection<T>::appendToken(Token& token, const char* at, size_t len) {
+  size_t offset = (at - _parseBase) - _messageStart;
+  if (token.length == 0) {
+    token.offset = offset;
+    token.length = len;
+    return;
+  }
+  size_t end = token.offset + token.length;
+  if (offset != end) {
+    // not contiguous (i.e. a folded header line), close the gap in place.
+    // the parser has already seen all of these bytes
+    std::memmove(_parseBase + _messageStart + end, at, len);
+  }
+  token.length += len;
+}
+
+template <SocketType T>
+void Connection<T>::bindRequest() {
+  char* base = bufferBegin() + _messageStart;
+  _url.length = _request->parseUrl(base + _url.offset, _url.length);
+  _request->headers.clear();
+  for (auto const& it : _headerTokens) {
+    _request->headers.add(tokenView(it.first), tokenView(it.second));
+  }
+}
+
 template <SocketType T>
 Connection<T>::Connection(Server& server, std::unique_ptr<AsioSocket<T>> so)
-    : _server(server), _protocol(std::move(so)) {
+    : _server(server),
+      _protocol(std::move(so)),
+      _messageStart(0),
+      _parsedBytes(0),
+      _parseBase(nullptr),
+      _request(std::make_unique<Request>()),
+      _pinned(false),
+      _lastHeaderWasValue(false),
+      _shouldKeepAlive(false),
+      _denyCredentials(false),
+      _awaitingResponse(false),
+      _bodyOffset(0),
+      _bodyPaused(false),
+      _chunkStart(0),
+      _flushing(0),
+      _writing(false),
+      _closeAfterFlush(false),
+      _streaming(false),
+      _draining(false),
+      _registered(false) {
   // initialize http parsing code
   llhttp_settings_init(&_parserSettings);
   _parserSettings.on_message_begin = Connection<T>::on_message_began;
@@ -155,22 +260,45 @@ Connection<T>::Connection(Server& server, std::unique_ptr<AsioSocket<T>> so)
 }
 
 template <SocketType T>
-Connection<T>::~Connection() {}
+Connection<T>::~Connection() {
+  // not closed, e.g. after the client ended the connection. This runs on
+  // the io thread, like unlinking the timeout entry of the socket
+  if (_registered) {
+    _protocol->context.removeConnection(this);
+  }
+}
 
 template <SocketType T>
 void Connection<T>::start() {
+  _protocol->context.addConnection(this);
+  _registered = true;
+  // accepted while the server started to shut down, this connection
+  // still answers one request
+  _draining = _server.draining();
   _protocol->setNonBlocking(true);
+  // replaces the handshake timeout, the socket is owned by this connection
+  _protocol->timeout.callback = [this]() {
+    LOG_DEBUG("connection timeout, closing stream!");
+    close();
+  };
+  armKeepAliveTimer();
   asyncReadSome();
 }
 
 template <SocketType T>
 void Connection<T>::close() {
+  // its BodyControl references this connection
+  _bodyConsumer.reset();
+  if (_registered) {
+    _protocol->context.removeConnection(this);
+    _registered = false;
+  }
   if (_protocol) {
-    _protocol->timer.cancel();
+    _protocol->timeout.cancel();
     asio::error_code ec;
     _protocol->shutdown(ec);
     if (ec) {
-      std::cout << "error shutting down asio socket: '" << ec.message() << "'";
+      LOG_DEBUG("error shutting down asio socket: '", ec.message(), "'");
     }
   }
 }
@@ -181,8 +309,9 @@ void Connection<T>::asyncReadSome() {
   // first try a sync read for performance
   if (_protocol->supportsMixedIO()) {
     std::size_t available = _protocol->available(ec);
-    while (!ec && available > 8) {
-      auto mutableBuff = _protocol->buffer.prepare(available);
+    while (!ec && available > 0) {
+      auto mutableBuff = _protocol->buffer.prepare(
+          std::min<size_t>(available, ReadBuffer::BlockSize));
       size_t nread = _protocol->socket.read_some(mutableBuff, ec);
       _protocol->buffer.commit(nread);
       if (ec) {
@@ -199,7 +328,30 @@ void Connection<T>::asyncReadSome() {
   }
 
   // read pipelined requests / remaining data
-  if (_protocol->buffer.size() > 0 && !readCallback(ec)) {
+  while (_protocol->buffer.size() > _parsedBytes) {
+    if (!readCallback(ec)) {
+      return;
+    }
+  }
+  if (!_pinned) {  // everything was parsed, give the buffer back
+    releaseParsed();
+  }
+
+  // TLS connections always have buffers in the ssl stream, and waiting
+  // for the kernel would miss bytes asio holds back from OpenSSL
+  if (_server.options().readinessWait && _protocol->supportsMixedIO() &&
+      T != SocketType::Ssl) {
+    auto cb = [self = this->shared_from_this()](asio::error_code const& ec) {
+      auto* thisPtr = static_cast<Connection<T>*>(self.get());
+      if (ec) {
+        thisPtr->readCallback(ec);
+      } else {
+        thisPtr->readAfterWait();
+      }
+    };
+    _protocol->socket.lowest_layer().async_wait(
+        asio::socket_base::wait_read,
+        makeCustomAllocHandler(_handlerMemory, std::move(cb)));
     return;
   }
 
@@ -212,7 +364,47 @@ void Connection<T>::asyncReadSome() {
     }
   };
   auto mutableBuff = _protocol->buffer.prepare(READ_BLOCK_SIZE);
-  _protocol->socket.async_read_some(mutableBuff, std::move(cb));
+  _protocol->socket.async_read_some(
+      mutableBuff, makeCustomAllocHandler(_handlerMemory, std::move(cb)));
+}
+
+template <SocketType T>
+void Connection<T>::readAfterWait() {
+  asio::error_code ec;
+  size_t available = _protocol->available(ec);
+  available = std::min<size_t>(std::max<size_t>(available, 1024),
+                               ReadBuffer::BlockSize);
+  auto mutableBuff = _protocol->buffer.prepare(available);
+  size_t nread = _protocol->socket.read_some(mutableBuff, ec);
+  _protocol->buffer.commit(nread);
+  if (ec == asio::error::would_block) {  // spurious wakeup
+    asyncReadSome();
+  } else if (readCallback(ec)) {
+    asyncReadSome();
+  }
+}
+
+template <SocketType T>
+void Connection<T>::releaseParsed() {
+  size_t release =
+      _pinned ? std::min(_messageStart, _parsedBytes) : _parsedBytes;
+  this->_protocol->buffer.consume(release);
+  _parsedBytes -= release;
+  _messageStart = _pinned ? _messageStart - release : 0;
+}
+
+template <SocketType T>
+bool Connection<T>::idle() const {
+  return !_pinned && !_awaitingResponse && !_writing && _responses.empty() &&
+         _parsedBytes == _protocol->buffer.size();
+}
+
+template <SocketType T>
+void Connection<T>::drain() {
+  _draining = true;
+  if (idle()) {
+    close();
+  }
 }
 
 template <SocketType T>
@@ -221,36 +413,54 @@ bool Connection<T>::readCallback(asio::error_code ec) {
   if (ec) {  // got a connection error
     if (ec == asio::error::misc_errors::eof) {
       err = llhttp_finish(&_parser);
+    } else if (ec == asio::error::operation_aborted) {
+      return false;  // closed by us, e.g. an idle connection while draining
     } else {
       llhttp_set_error_reason(&_parser, "Error while reading from socket");
-      std::cout << "Error while reading from socket: '" << ec.message() << "'";
+      LOG_DEBUG("Error while reading from socket: '", ec.message(), "'");
       err = HPE_CLOSED_CONNECTION;
     }
   } else {  // Inspect the received data
 
-    size_t parsedBytes = 0;
-    for (auto const& buffer : this->_protocol->buffer.data()) {
-      const char* data = reinterpret_cast<const char*>(buffer.data());
-      err = llhttp_execute(&_parser, data, buffer.size());
-      if (err != HPE_OK) {
-        parsedBytes += llhttp_get_error_pos(&_parser) - data;
-        break;
+    // the receive buffer is contiguous and the bytes of the current
+    // message are kept, so tokens never span two segments
+    _parseBase = bufferBegin();
+    size_t size = this->_protocol->buffer.size();
+    assert(_parsedBytes <= size);
+    err = llhttp_execute(&_parser, _parseBase + _parsedBytes,
+                         size - _parsedBytes);
+    if (err != HPE_OK) {
+      _parsedBytes = llhttp_get_error_pos(&_parser) - _parseBase;
+    } else {
+      _parsedBytes = size;
+    }
+
+    if (_bodyOffset != 0) {
+      // body chunks are consumed or copied, only keep the header
+      size_t keep = _messageStart + _bodyOffset;
+      if (_parsedBytes > keep) {
+        _protocol->buffer.erase(keep, _parsedBytes - keep);
+        _parsedBytes = keep;
       }
-      parsedBytes += buffer.size();
     }
 
-    assert(parsedBytes < std::numeric_limits<size_t>::max());
-    // Remove consumed data from receive buffer.
-    this->_protocol->buffer.consume(parsedBytes);
+    // Remove consumed data from receive buffer, the current request
+    // references its bytes until the response is sent
+    releaseParsed();
+    _parseBase = nullptr;
 
     if (err == HPE_PAUSED_UPGRADE) {
       this->addSimpleResponse(rest::ResponseCode::NOT_IMPLEMENTED);
+    } else if (!_responses.empty()) {
+      if (!flushResponses()) {
+        return false;  // the write completion continues reading
+      }
+      err = llhttp_get_errno(&_parser);
     }
   }
 
   if (err != HPE_OK && err != HPE_USER && err != HPE_PAUSED) {
-    std::cout << "HTTP parse failure: '" << llhttp_get_error_reason(&_parser)
-              << "'";
+    LOG_WARN("HTTP parse failure: '", llhttp_get_error_reason(&_parser), "'");
     this->close();
   }
 
@@ -261,11 +471,11 @@ template <SocketType T>
 void Connection<T>::processRequest() {
   assert(_request);
 
-  this->_protocol->timer.cancel();
+  this->_protocol->timeout.cancel();
 
-  std::cout << "\"http-request-begin\",\"" << (void*)this << "\",\""
-            << _protocol->peer.address().to_string() << "\",\""
-            << "\"";
+  // the endpoint is copied, it is only formatted by the log flusher
+  LOG_DEBUG("\"http-request-begin\",\"", (void*)this, "\",\"",
+            _protocol->peer, "\",\"\"");
 
   parseOriginHeader(*_request);
 
@@ -277,9 +487,46 @@ void Connection<T>::processRequest() {
 
   // TODO scrape authentication, etc
 
-  auto response = _server.execute(*_request);
+  _awaitingResponse = true;
+  if (_bodyConsumer) {
+    _server.completeBodyStream(*_request, *this, std::move(_bodyConsumer));
+    return;
+  }
+  auto response = _server.execute(*_request, *this);
+  if (response) {
+    sendResponse(std::move(response));
+  }
+}
 
-  sendResponse(std::move(response));
+template <SocketType T>
+void Connection<T>::resumeBody() {
+  // always posted, the consumer may call this before onData() returns
+  auto fn = [self = this->shared_from_this()]() {
+    auto* thisPtr = static_cast<Connection<T>*>(self.get());
+    if (!thisPtr->_bodyPaused) {
+      return;
+    }
+    thisPtr->_bodyPaused = false;
+    // otherwise responsesWritten() resumes
+    if (!thisPtr->_writing && thisPtr->resumeParser()) {
+      thisPtr->asyncReadSome();
+    }
+  };
+  asio::post(_protocol->context.io_context, std::move(fn));
+}
+
+template <SocketType T>
+void Connection<T>::postResponse(std::shared_ptr<AbstrConn> self,
+                                 std::unique_ptr<Response> response) {
+  asio::io_context& ioContext = _protocol->context.io_context;
+  if (ioContext.get_executor().running_in_this_thread()) {
+    sendResponse(std::move(response));
+    return;
+  }
+  auto fn = [self = std::move(self), r = std::move(response)]() mutable {
+    static_cast<Connection<T>*>(self.get())->sendResponse(std::move(r));
+  };
+  asio::post(ioContext, std::move(fn));
 }
 
 /// @brief send error response including response body
@@ -290,7 +537,7 @@ void Connection<T>::addSimpleResponse(rest::ResponseCode code) {
     resp->status_code = code;
     sendResponse(std::move(resp));
   } catch (...) {
-    std::cout << "addSimpleResponse received an exception, closing connection";
+    LOG_WARN("addSimpleResponse received an exception, closing connection");
     this->close();
   }
 }
@@ -298,7 +545,7 @@ void Connection<T>::addSimpleResponse(rest::ResponseCode code) {
 template <SocketType T>
 void Connection<T>::parseOriginHeader(rest::Request const& req) {
   // handle origin headers
-  _origin = req.header("origin");
+  _origin = req.headers.get(KnownHeader::Origin);
   if (!_origin.empty()) {
     // default is to allow nothing
     _denyCredentials = true;
@@ -344,8 +591,8 @@ void Connection<T>::processCorsOptions() {
   resp->setHeaderNCIfNotSet("Allow", allowedMethods);
 
   if (!_origin.empty()) {
-    std::cout << "got CORS preflight request";
-    std::string const allowHeaders =
+    LOG_DEBUG("got CORS preflight request");
+    std::string_view allowHeaders =
         utils::trim(_request->header("access-control-request-headers"));
 
     resp->setHeaderNCIfNotSet("access-control-allow-methods", allowedMethods);
@@ -355,17 +602,17 @@ void Connection<T>::processCorsOptions() {
       // we don't verify them here. the worst that can happen is that the
       // client sends some broken headers and then later cannot access the data
       // on the server. that's a client problem.
-      resp->setHeaderNCIfNotSet("access-control-allow-headers", allowHeaders);
+      resp->setHeaderNCIfNotSet("access-control-allow-headers",
+                                std::string(allowHeaders));
 
-      std::cout << "client requested validation of the following headers: "
-                << allowHeaders;
+      LOG_DEBUG("client requested validation of the following headers: ",
+                std::string(allowHeaders));
     }
 
     // set caching time (hard-coded value)
     resp->setHeaderNCIfNotSet("access-control-max-age", "1800");
   }
 
-  _request.reset();  // forge the request
   sendResponse(std::move(resp));
 }
 
@@ -375,10 +622,11 @@ void Connection<T>::sendResponse(std::unique_ptr<Response> response) {
   if (!_origin.empty()) {
     // the request contained an Origin header. We have to send back the
     // access-control-allow-origin header now
-    std::cout << "handling CORS response";
+    LOG_DEBUG("handling CORS response");
 
     // send back original value of "Origin" header
-    response->setHeaderNCIfNotSet("access-control-allow-origin", _origin);
+    response->setHeaderNCIfNotSet("access-control-allow-origin",
+                                  std::string(_origin));
 
     // send back "Access-Control-Allow-Credentials" header
     response->setHeaderNCIfNotSet("access-control-allow-credentials",
@@ -391,44 +639,354 @@ void Connection<T>::sendResponse(std::unique_ptr<Response> response) {
         "etag, content-encoding, content-length, location, server");
   }
 
-  std::unique_ptr<std::string> header = response->generateHeader();
-  std::unique_ptr<std::string> body = std::move(response->body);
-  std::array<asio::const_buffer, 2> buffers;
-  buffers[0] = asio::buffer(header->data(), header->size());
-  if (HTTP_HEAD != _parser.method) {
-    buffers[1] = asio::buffer(body->data(), body->size());
+  if (response->producer && _parser.http_minor == 0) {
+    // HTTP/1.0 has no chunked encoding, send the body in one piece
+    std::unique_ptr<std::string> body = std::move(response->body);
+    if (!body) {
+      body = std::make_unique<std::string>();
+    }
+    while (response->producer->produce(*body)) {
+    }
+    response->producer.reset();
+    response->body = std::move(body);
   }
 
-  // FIXME measure performance w/o sync write
-  auto cb = [self = this->shared_from_this(), h = std::move(header),
-             b = std::move(body)](asio::error_code ec, size_t nwrite) {
-    auto* thisPtr = static_cast<Connection<T>*>(self.get());
+  // headers of all queued responses share one buffer, it keeps its capacity
+  bool const keepAlive = _shouldKeepAlive && !_draining;
+  size_t offset = _writeBuffer.size();
+  response->writeHeader(_writeBuffer, keepAlive);
+  QueuedResponse queued;
+  queued.headerOffset = offset;
+  queued.headerLength = _writeBuffer.size() - offset;
+  queued.body = std::move(response->body);
+  queued.producer = std::move(response->producer);
+  if (HTTP_HEAD == _parser.method ||
+      response->status_code == ResponseCode::NOT_MODIFIED) {
+    queued.body.reset();
+    queued.producer.reset();
+  } else if (response->file) {
+    if (sendsFiles()) {
+      queued.file = std::move(response->file);
+      queued.fileOffset = response->fileOffset;
+      queued.fileLength = response->fileLength;
+    } else {  // the file is encrypted in user space anyway
+      queued.producer = std::make_unique<FileProducer>(
+          std::move(response->file), response->fileOffset,
+          response->fileLength);
+      queued.chunked = false;
+    }
+  }
+  _responses.push_back(std::move(queued));
+  _awaitingResponse = false;
+  if (!keepAlive) {
+    _closeAfterFlush = true;
+  }
+  // the request is answered, its bytes can be released
+  _origin = std::string_view();
+  _pinned = false;
+
+  // while the parser runs the responses are collected and readCallback()
+  // flushes them at the end
+  if (_parseBase == nullptr && !_writing && flushResponses()) {
+    asyncReadSome();
+  }
+}
 
-    llhttp_errno_t err = llhttp_get_errno(&thisPtr->_parser);
-    if (ec || !thisPtr->_shouldKeepAlive || err != HPE_PAUSED) {
-      if (ec) {
-        std::cout << "asio write error: '" << ec.message() << "'";
+template <SocketType T>
+bool Connection<T>::flushResponses() {
+  assert(!_writing && !_responses.empty());
+  _writeBuffers.clear();
+  _flushing = 0;
+  bool const continued = _streaming;
+
+  if (_streaming) {  // the next chunk of the first response
+    QueuedResponse& front = _responses.front();
+    if (front.file) {
+      return sendFile();
+    }
+    if (nextChunk(front.producer, front.chunked)) {
+      _flushing = 1;
+    }
+    _writeBuffers.emplace_back(_chunkBuffer.data() + _chunkStart,
+                               _chunkBuffer.size() - _chunkStart);
+  } else {
+    // the headers in flight must not move, sendResponse() may append to
+    // _writeBuffer before the write completes
+    _inflightHeaders.swap(_writeBuffer);
+
+    // [header, body, header, header, body, ...], consecutive headers are
+    // contiguous and merged into one buffer. A streamed body ends the
+    // sequence, the responses behind it wait
+    size_t headerStart = 0;
+    size_t headerEnd = 0;
+    QueuedResponse* stream = nullptr;
+    for (QueuedResponse& r : _responses) {
+      headerEnd = r.headerOffset + r.headerLength;
+      if (r.producer || r.file) {
+        stream = &r;
+        break;
+      }
+      ++_flushing;
+      if (r.body && !r.body->empty()) {
+        _writeBuffers.emplace_back(_inflightHeaders.data() + headerStart,
+                                   headerEnd - headerStart);
+        _writeBuffers.emplace_back(r.body->data(), r.body->size());
+        headerStart = headerEnd;
+      }
+    }
+    if (headerStart < headerEnd) {
+      _writeBuffers.emplace_back(_inflightHeaders.data() + headerStart,
+                                 headerEnd - headerStart);
+    }
+
+    _writeBuffer.assign(_inflightHeaders, headerEnd, std::string::npos);
+    for (QueuedResponse& r : _responses) {
+      r.headerOffset = r.headerOffset < headerEnd ? 0
+                                                  : r.headerOffset - headerEnd;
+    }
+    if (stream != nullptr) {
+      stream->headerLength = 0;
+      _streaming = true;
+      if (stream->producer) {  // send the header with the first chunk
+        if (nextChunk(stream->producer, stream->chunked)) {
+          ++_flushing;
+        }
+        _writeBuffers.emplace_back(_chunkBuffer.data() + _chunkStart,
+                                   _chunkBuffer.size() - _chunkStart);
+      }
+    }
+  }
+
+  // turn on the keepAlive timer, unless a handler is still running
+  if (!_awaitingResponse) {
+    armKeepAliveTimer();
+  }
+
+  BufferSpan pending{_writeBuffers.data(),
+                     _writeBuffers.data() + _writeBuffers.size()};
+
+  // the send buffer is almost always empty, try to write without a
+  // reactor round trip first. Further chunks of a streamed body are
+  // written asynchronously, the producer runs again once the socket is
+  // writable (and not recursively)
+  if (_server.options().syncWrite && writesPlain() && !continued) {
+    asio::error_code ec;
+    size_t written = writeSome(pending, ec);
+    while (written > 0 && pending.first != pending.last) {
+      size_t n = std::min(written, pending.first->size());
+      *pending.first += n;
+      written -= n;
+      if (pending.first->size() == 0) {
+        ++pending.first;
       }
-      thisPtr->close();
-    } else {  // ec == HPE_PAUSED
-      llhttp_resume(&thisPtr->_parser);
+    }
+    if (pending.first == pending.last ||
+        (ec && ec != asio::error::would_block)) {
+      return responsesWritten(ec);
+    }
+  }
+
+  _writing = true;
+  auto cb = [self = this->shared_from_this()](asio::error_code ec, size_t) {
+    auto* thisPtr = static_cast<Connection<T>*>(self.get());
+    if (thisPtr->responsesWritten(ec)) {
       thisPtr->asyncReadSome();
     }
   };
-  asio::async_write(this->_protocol->socket, std::move(buffers), std::move(cb));
+  asyncWrite(pending, makeCustomAllocHandler(_handlerMemory, std::move(cb)));
+  return false;
+}
+
+template <SocketType T>
+bool Connection<T>::writesPlain() const {
+  if constexpr (T == SocketType::Ssl) {
+    return _protocol->kernelSend;
+  } else {
+    return true;
+  }
+}
+
+template <SocketType T>
+bool Connection<T>::sendsFiles() const {
+#ifdef __linux__
+  return writesPlain();
+#else
+  return false;
+#endif
+}
+
+template <SocketType T>
+size_t Connection<T>::writeSome(BufferSpan const& buffers,
+                                asio::error_code& ec) {
+  if constexpr (T == SocketType::Ssl) {
+    if (_protocol->kernelSend) {
+      return _protocol->socket.next_layer().write_some(buffers, ec);
+    }
+  }
+  return _protocol->socket.write_some(buffers, ec);
+}
+
+template <SocketType T>
+template <typename F>
+void Connection<T>::asyncWrite(BufferSpan const& buffers, F&& cb) {
+  if constexpr (T == SocketType::Ssl) {
+    if (_protocol->kernelSend) {
+      asio::async_write(_protocol->socket.next_layer(), buffers,
+                        std::forward<F>(cb));
+      return;
+    }
+  }
+  asio::async_write(_protocol->socket, buffers, std::forward<F>(cb));
+}
+
+template <SocketType T>
+bool Connection<T>::responsesWritten(asio::error_code const& ec) {
+  _writing = false;
+  if (ec) {
+    LOG_DEBUG("asio write error: '", ec.message(), "'");
+    this->close();
+    return false;
+  }
+
+  // responses of asynchronous handlers may have been queued meanwhile
+  _responses.erase(_responses.begin(), _responses.begin() + _flushing);
+  _flushing = 0;
+  if (!_responses.empty()) {
+    return flushResponses();
+  }
+
+  if (_closeAfterFlush || (_draining && idle())) {
+    this->close();
+    return false;
+  }
+
+  llhttp_errno_t err = llhttp_get_errno(&_parser);
+  if (err == HPE_PAUSED) {
+    if (_awaitingResponse || _bodyPaused) {
+      return false;  // sendResponse() or resumeBody() continues
+    }
+    return resumeParser();
+  } else if (err != HPE_OK) {
+    this->close();
+    return false;
+  }
+  return true;
+}
+
+template <SocketType T>
+bool Connection<T>::nextChunk(std::unique_ptr<BodyProducer>& producer,
+                              bool chunked) {
+  // "<size>\r\n<data>\r\n", the size is written in front of the data
+  // once it is known. Without chunked encoding only the data is sent
+  constexpr size_t Prefix = 2 * sizeof(size_t) + 2;
+  _chunkBuffer.assign(Prefix, '\0');
+  bool more = true;
+  while (more && _chunkBuffer.size() == Prefix) {
+    more = producer->produce(_chunkBuffer);
+  }
 
-  // turn on the keepAlive timer
-  this->_protocol->timer.expires_after(std::chrono::seconds(60));
-  this->_protocol->timer.async_wait([this](asio::error_code ec) {
-    if (!ec) {
-      std::cout << "keep alive timout, closing stream!";
-      this->close();
+  size_t len = _chunkBuffer.size() - Prefix;
+  _chunkStart = Prefix;
+  if (len > 0 && chunked) {
+    char* p = &_chunkBuffer[Prefix];
+    *--p = '\n';
+    *--p = '\r';
+    do {
+      *--p = "0123456789abcdef"[len & 0xf];
+      len >>= 4;
+    } while (len > 0);
+    _chunkStart = p - _chunkBuffer.data();
+    _chunkBuffer.append("\r\n");
+  }
+  if (!more) {
+    if (chunked) {
+      _chunkBuffer.append("0\r\n\r\n");
     }
-  });
+    producer.reset();
+    _streaming = false;
+  }
+  return !more;
+}
+
+template <SocketType T>
+bool Connection<T>::sendFile() {
+  QueuedResponse& r = _responses.front();
+  asio::error_code ec;
+#ifdef __linux__
+  // bounded, other connections of this thread get their turn in between
+  uint64_t budget = SendfileSlice;
+  int const out = _protocol->socket.lowest_layer().native_handle();
+  while (r.fileLength > 0 && budget > 0) {
+    off_t offset = static_cast<off_t>(r.fileOffset);
+    size_t count = std::min<uint64_t>(r.fileLength, budget);
+    ssize_t n = ::sendfile(out, r.file->fd, &offset, count);
+    if (n > 0) {
+      r.fileOffset += n;
+      r.fileLength -= n;
+      budget -= n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    // an error, or the file was truncated since the header was sent
+    ec = n < 0 ? asio::error_code(errno, asio::error::get_system_category())
+               : asio::error::eof;
+    return responsesWritten(ec);
+  }
+#endif
+
+  if (r.fileLength == 0) {
+    r.file.reset();
+    _streaming = false;
+    _flushing = 1;
+    return responsesWritten(ec);
+  }
+
+  if (!_awaitingResponse) {
+    armKeepAliveTimer();
+  }
+  _writing = true;
+  auto cb = [self = this->shared_from_this()](asio::error_code const& ec) {
+    auto* thisPtr = static_cast<Connection<T>*>(self.get());
+    thisPtr->_writing = false;
+    if (ec ? thisPtr->responsesWritten(ec) : thisPtr->sendFile()) {
+      thisPtr->asyncReadSome();
+    }
+  };
+  if (budget == 0) {  // still writable, yield
+    auto next = [cb = std::move(cb)]() { cb(asio::error_code()); };
+    asio::post(_protocol->context.io_context,
+               makeCustomAllocHandler(_handlerMemory, std::move(next)));
+  } else {
+    _protocol->socket.lowest_layer().async_wait(
+        asio::socket_base::wait_write,
+        makeCustomAllocHandler(_handlerMemory, std::move(cb)));
+  }
+  return false;
+}
+
+template <SocketType T>
+bool Connection<T>::resumeParser() {
+  llhttp_resume(&_parser);
+  if (_protocol->buffer.size() > _parsedBytes) {
+    return true;  // asyncReadSome() parses the remaining data
+  }
+  // the message may be complete without more data, e.g. if the
+  // consumer paused on the last body chunk
+  return readCallback(asio::error_code());
+}
+
+template <SocketType T>
+void Connection<T>::armKeepAliveTimer() {
+  _protocol->context.timers.schedule(_protocol->timeout, KeepAliveTimeout);
 }
 
 template class asiodemo::rest::Connection<SocketType::Tcp>;
 template class asiodemo::rest::Connection<SocketType::Ssl>;
-//#ifndef _WIN32
-// template class asiodemo::rest::Connection<SocketType::Unix>;
-//#endif
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+template class asiodemo::rest::Connection<SocketType::Unix>;
+#endif
@@ -8,17 +8,37 @@
 #define CONNECTION_H 1
 
 #include "AsioSocket.h"
+#include "HandlerMemory.h"
 #include "Request.h"
+#include "Responder.h"
 #include "Response.h"
 
 #include <llhttp.h>
 
+#include <string_view>
+#include <vector>
+
 namespace asiodemo { namespace rest {
 
 class Server;
 struct Request;
 
-class AbstrConn : public std::enable_shared_from_this<AbstrConn> {};
+class AbstrConn : public std::enable_shared_from_this<AbstrConn> {
+ public:
+  virtual ~AbstrConn() = default;
+
+  /// answer the request the connection is waiting for, may be called
+  /// from any thread (see Responder). `self` owns this connection, it is
+  /// moved into the handler posted to the io thread
+  virtual void postResponse(std::shared_ptr<AbstrConn> self,
+                            std::unique_ptr<Response> response) = 0;
+  /// continue a streamed request body, may be called from any thread
+  /// (see BodyControl)
+  virtual void resumeBody() = 0;
+  /// the server shuts down: close at once if no request is in progress,
+  /// otherwise after the response to it. Called on the io thread
+  virtual void drain() = 0;
+};
 
 template <SocketType T>
 class Connection : public AbstrConn {
@@ -30,6 +50,11 @@ class Connection : public AbstrConn {
   void start();
   void close();
 
+  void postResponse(std::shared_ptr<AbstrConn> self,
+                    std::unique_ptr<Response> response) override;
+  void resumeBody() override;
+  void drain() override;
+
  private:
   static int on_message_began(llhttp_t* p);
   static int on_url(llhttp_t* p, const char* at, size_t len);
@@ -43,17 +68,59 @@ class Connection : public AbstrConn {
  private:
   /// read from socket
   void asyncReadSome();
+  /// read the data of a socket that became readable
+  void readAfterWait();
+  /// drop the parsed bytes not referenced by the current request
+  void releaseParsed();
+  /// between two requests, nothing received or queued
+  bool idle() const;
 
   /// default max chunksize is 30kb in arangodb (each read fits)
-  static constexpr size_t READ_BLOCK_SIZE = 1024 * 32;
+  static constexpr size_t READ_BLOCK_SIZE = ReadBuffer::BlockSize;
 
+  /// queue the response, it is written immediately unless the parser is
+  /// running (pipelined responses are flushed together)
   void sendResponse(std::unique_ptr<rest::Response> response);
+  /// write all queued responses with one gathered write. Returns true if
+  /// they were written inline and the connection can continue reading,
+  /// otherwise the write completion (or close) takes over
+  bool flushResponses();
+  /// the queued responses are written, returns false if the connection
+  /// is closed instead of reading the next request
+  bool responsesWritten(asio::error_code const& ec);
+  /// continue a paused parser, returns false if the connection must not
+  /// read (yet)
+  bool resumeParser();
+  /// frame the next piece of a streamed body in _chunkBuffer, returns
+  /// true if it was the last one
+  bool nextChunk(std::unique_ptr<BodyProducer>& producer, bool chunked);
+  /// send the file of the first queued response with sendfile(2), same
+  /// contract as flushResponses()
+  bool sendFile();
+  void armKeepAliveTimer();
 
   /// @brief send error response including response body
   void addSimpleResponse(rest::ResponseCode);
 
   bool readCallback(asio::error_code ec);
 
+  /// position of a token relative to _messageStart in the receive buffer
+  struct Token {
+    size_t offset = 0;
+    size_t length = 0;
+  };
+
+  /// start of the receive buffer
+  char* bufferBegin() const;
+  /// append data passed to a parser callback to a token
+  void appendToken(Token& token, const char* at, size_t len);
+  std::string_view tokenView(Token const& token) const {
+    return std::string_view(bufferBegin() + _messageStart + token.offset,
+                            token.length);
+  }
+  /// point the views of _request to the current receive buffer
+  void bindRequest();
+
   void processRequest();
 
   void parseOriginHeader(rest::Request const& req);
@@ -66,6 +133,8 @@ class Connection : public AbstrConn {
 
  private:
   rest::Server& _server;
+  /// declared before _protocol, pending operations are destroyed with it
+  HandlerMemory _handlerMemory;
   std::unique_ptr<AsioSocket<T>> _protocol;
 
   /// the node http-parser
@@ -73,13 +142,84 @@ class Connection : public AbstrConn {
   llhttp_settings_t _parserSettings;
 
   // ==== parser state ====
-  std::string _lastHeaderField;
-  std::string _lastHeaderValue;
-  std::string _origin;  // value of the HTTP origin header the client sent (if
+  /// start of the current message in the receive buffer
+  size_t _messageStart;
+  /// bytes at the front of the receive buffer already seen by the parser
+  size_t _parsedBytes;
+  /// receive buffer start during llhttp_execute
+  char* _parseBase;
+  Token _url;
+  std::vector<std::pair<Token, Token>> _headerTokens;
+  std::string_view _origin;  // value of the HTTP origin header the client sent
+  /// reused for every request, views into the receive buffer
   std::unique_ptr<Request> _request;
+  /// the bytes of the current message are in use, do not consume them
+  bool _pinned;
   bool _lastHeaderWasValue;
   bool _shouldKeepAlive;  /// keep connection open
   bool _denyCredentials;  /// credentialed requests or not (only CORS)
+  /// the handler of the current request has not answered yet, the parser
+  /// stays paused and the request keeps its bytes
+  bool _awaitingResponse;
+  /// consumer of a streamed request body
+  std::unique_ptr<BodyConsumer> _bodyConsumer;
+  /// end of the header relative to _messageStart once it is complete,
+  /// 0 before. Parsed body bytes after it are dropped
+  size_t _bodyOffset;
+  /// the body consumer is busy, reading is paused
+  bool _bodyPaused;
+
+  // ==== response queue ====
+  struct QueuedResponse {
+    /// serialized header in _writeBuffer
+    size_t headerOffset = 0;
+    size_t headerLength = 0;
+    std::unique_ptr<std::string> body;
+    /// streamed body, reset after the last chunk
+    std::unique_ptr<BodyProducer> producer;
+    /// file body, sent with sendfile(2)
+    std::shared_ptr<StaticFile const> file;
+    uint64_t fileOffset = 0;
+    uint64_t fileLength = 0;
+    /// the producer's pieces are framed as chunks
+    bool chunked = true;
+  };
+  /// non-owning buffer sequence, asio copies it into the write operation
+  struct BufferSpan {
+    typedef asio::const_buffer value_type;
+    typedef asio::const_buffer* const_iterator;
+    const_iterator begin() const { return first; }
+    const_iterator end() const { return last; }
+    asio::const_buffer* first;
+    asio::const_buffer* last;
+  };
+  /// writes bypass OpenSSL: plain sockets and TLS sockets encrypted by
+  /// the kernel (kTLS)
+  bool writesPlain() const;
+  /// file bodies bypass user space, otherwise they are read into pieces
+  bool sendsFiles() const;
+  size_t writeSome(BufferSpan const& buffers, asio::error_code& ec);
+  template <typename F>
+  void asyncWrite(BufferSpan const& buffers, F&& cb);
+  /// responses in request order, not yet written
+  std::vector<QueuedResponse> _responses;
+  /// serialized headers of all queued responses, reused
+  std::string _writeBuffer;
+  /// headers of the write in flight, swapped with _writeBuffer
+  std::string _inflightHeaders;
+  /// framed chunk of a streamed body, starting at _chunkStart
+  std::string _chunkBuffer;
+  size_t _chunkStart;
+  std::vector<asio::const_buffer> _writeBuffers;
+  /// number of queued responses in the write in flight
+  size_t _flushing;
+  bool _writing;          /// async write in flight
+  bool _closeAfterFlush;  /// a queued response ends the connection
+  bool _streaming;        /// the first queued response streams its body
+  /// the server shuts down, the next response ends the connection
+  bool _draining;
+  /// tracked by the io context until closed
+  bool _registered;
 
   bool _checkedVstUpgrade;
 };
@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HANDLER_MEMORY_H
+#define HANDLER_MEMORY_H 1
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <asio/associated_allocator.hpp>
+
+namespace asiodemo { namespace rest {
+
+/// Memory for the operations asio allocates for the completion handlers
+/// of one connection. A connection has at most one read (or readiness
+/// wait) and one write in flight, each fits into one of the slots. Larger
+/// or additional operations fall back to the heap and are counted.
+/// Not thread-safe, a connection only runs on its io thread.
+class HandlerMemory {
+ public:
+  static constexpr size_t NumSlots = 2;
+  /// the gathered async_write of a response needs 424 bytes (x86-64)
+  static constexpr size_t SlotSize = 512;
+
+  HandlerMemory() : _inUse(0) {}
+  HandlerMemory(HandlerMemory const&) = delete;
+  HandlerMemory& operator=(HandlerMemory const&) = delete;
+
+  void* allocate(size_t size) {
+    if (size <= SlotSize) {
+      for (size_t i = 0; i < NumSlots; ++i) {
+        if ((_inUse & (1u << i)) == 0) {
+          _inUse |= (1u << i);
+          return &_slots[i];
+        }
+      }
+    }
+    _heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(size);
+  }
+
+  void deallocate(void* p) {
+    for (size_t i = 0; i < NumSlots; ++i) {
+      if (p == &_slots[i]) {
+        _inUse &= ~(1u << i);
+        return;
+      }
+    }
+    ::operator delete(p);
+  }
+
+  /// operations of all connections that did not fit into their slots
+  static uint64_t heapAllocations() {
+    return _heapAllocations.load(std::memory_order_relaxed);
+  }
+
+ private:
+  typename std::aligned_storage<SlotSize, alignof(std::max_align_t)>::type
+      _slots[NumSlots];
+  unsigned _inUse;
+
+  inline static std::atomic<uint64_t> _heapAllocations{0};
+};
+
+/// allocator handed to asio through associated_allocator
+template <typename T>
+class HandlerAllocator {
+ public:
+  typedef T value_type;
+
+  explicit HandlerAllocator(HandlerMemory& mem) : _memory(mem) {}
+
+  template <typename U>
+  HandlerAllocator(HandlerAllocator<U> const& other) noexcept
+      : _memory(other._memory) {}
+
+  bool operator==(HandlerAllocator const& other) const noexcept {
+    return &_memory == &other._memory;
+  }
+  bool operator!=(HandlerAllocator const& other) const noexcept {
+    return &_memory != &other._memory;
+  }
+
+  T* allocate(size_t n) const {
+    return static_cast<T*>(_memory.allocate(sizeof(T) * n));
+  }
+  void deallocate(T* p, size_t /*n*/) const { _memory.deallocate(p); }
+
+ private:
+  template <typename>
+  friend class HandlerAllocator;
+
+  HandlerMemory& _memory;
+};
+
+/// completion handler wrapper that allocates from HandlerMemory
+template <typename Handler>
+class CustomAllocHandler {
+ public:
+  typedef HandlerAllocator<Handler> allocator_type;
+
+  CustomAllocHandler(HandlerMemory& m, Handler&& h)
+      : _memory(m), _handler(std::move(h)) {}
+
+  allocator_type get_allocator() const noexcept {
+    return allocator_type(_memory);
+  }
+
+  template <typename... Args>
+  void operator()(Args&&... args) {
+    _handler(std::forward<Args>(args)...);
+  }
+
+ private:
+  HandlerMemory& _memory;
+  Handler _handler;
+};
+
+template <typename Handler>
+inline CustomAllocHandler<typename std::decay<Handler>::type>
+makeCustomAllocHandler(HandlerMemory& m, Handler&& h) {
+  return CustomAllocHandler<typename std::decay<Handler>::type>(
+      m, std::forward<Handler>(h));
+}
+
+}}  // namespace asiodemo::rest
+
+#endif
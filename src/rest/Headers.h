@@ -0,0 +1,220 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HEADERS_H
+#define HEADERS_H 1
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace asiodemo { namespace rest {
+
+/// headers with an O(1) lookup in HeaderMap
+enum class KnownHeader : uint8_t {
+  ContentLength = 0,
+  Connection,
+  Host,
+  Origin,
+  Expect,
+  AcceptEncoding,
+  ContentType,
+  TransferEncoding,
+  ETag,
+  Unknown  // must be last
+};
+
+constexpr size_t NumKnownHeaders = static_cast<size_t>(KnownHeader::Unknown);
+
+namespace headers {
+
+constexpr char toLower(char c) {
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+/// case-insensitive FNV-1a
+constexpr uint32_t hash(std::string_view name) {
+  uint32_t h = 2166136261u;
+  for (char c : name) {
+    h ^= static_cast<uint8_t>(toLower(c));
+    h *= 16777619u;
+  }
+  return h;
+}
+
+inline bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (toLower(a[i]) != toLower(b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// lower case names, indexed by KnownHeader
+constexpr std::array<std::string_view, NumKnownHeaders> knownNames = {
+    {"content-length", "connection", "host", "origin", "expect",
+     "accept-encoding", "content-type", "transfer-encoding", "etag"}};
+
+constexpr std::array<uint32_t, NumKnownHeaders> knownHashes = {
+    {hash(knownNames[0]), hash(knownNames[1]), hash(knownNames[2]),
+     hash(knownNames[3]), hash(knownNames[4]), hash(knownNames[5]),
+     hash(knownNames[6]), hash(knownNames[7]), hash(knownNames[8])}};
+
+inline KnownHeader classify(uint32_t h, std::string_view name) {
+  for (size_t i = 0; i < NumKnownHeaders; ++i) {
+    if (knownHashes[i] == h && equalsIgnoreCase(knownNames[i], name)) {
+      return static_cast<KnownHeader>(i);
+    }
+  }
+  return KnownHeader::Unknown;
+}
+}  // namespace headers
+
+/// Flat header container, the first InlineCapacity entries are stored
+/// inline. Names are compared case-insensitively by their precomputed
+/// hash, the well-known headers are found in O(1).
+/// `String` is std::string_view for requests (views into the receive
+/// buffer) and std::string for responses.
+template <typename String>
+class HeaderMap {
+ public:
+  static constexpr size_t InlineCapacity = 16;
+
+  struct Entry {
+    uint32_t hash = 0;
+    String name;
+    String value;
+  };
+
+  HeaderMap() : _size(0) { _known.fill(0); }
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+
+  Entry const* begin() const { return data(); }
+  Entry const* end() const { return data() + _size; }
+
+  /// forget all entries, keeps allocated memory
+  void clear() {
+    _size = 0;
+    _overflow.clear();
+    _known.fill(0);
+  }
+
+  /// add a header, duplicates are kept and lookups return the first
+  void add(String name, String value) {
+    uint32_t h = headers::hash(name);
+    KnownHeader known = headers::classify(h, name);
+    append(h, known, std::move(name), std::move(value));
+  }
+
+  /// add a header unless there is one with the same name,
+  /// returns true if it was added
+  bool setIfNotSet(std::string_view name, String value) {
+    uint32_t h = headers::hash(name);
+    KnownHeader known = headers::classify(h, name);
+    if (indexOf(h, known, name) != npos) {
+      return false;
+    }
+    append(h, known, String(name), std::move(value));
+    return true;
+  }
+
+  std::string_view get(std::string_view name, bool& found) const {
+    uint32_t h = headers::hash(name);
+    size_t i = indexOf(h, headers::classify(h, name), name);
+    found = i != npos;
+    return found ? std::string_view(data()[i].value) : std::string_view();
+  }
+  std::string_view get(std::string_view name) const {
+    bool found;
+    return get(name, found);
+  }
+
+  std::string_view get(KnownHeader known, bool& found) const {
+    size_t i = indexOf(known);
+    found = i != npos;
+    return found ? std::string_view(data()[i].value) : std::string_view();
+  }
+  std::string_view get(KnownHeader known) const {
+    bool found;
+    return get(known, found);
+  }
+
+  bool contains(KnownHeader known) const { return indexOf(known) != npos; }
+
+ private:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  Entry* data() {
+    return _overflow.empty() ? _inline.data() : _overflow.data();
+  }
+  Entry const* data() const {
+    return _overflow.empty() ? _inline.data() : _overflow.data();
+  }
+
+  size_t indexOf(KnownHeader known) const {
+    uint8_t slot = _known[static_cast<size_t>(known)];
+    if (slot != 0 || _size <= UINT8_MAX) {
+      return slot == 0 ? npos : slot - 1;
+    }
+    size_t i = static_cast<size_t>(known);
+    return indexOf(headers::knownHashes[i], KnownHeader::Unknown,
+                   headers::knownNames[i]);
+  }
+
+  size_t indexOf(uint32_t h, KnownHeader known, std::string_view name) const {
+    if (known != KnownHeader::Unknown) {
+      return indexOf(known);
+    }
+    Entry const* entries = data();
+    for (size_t i = 0; i < _size; ++i) {
+      if (entries[i].hash == h &&
+          headers::equalsIgnoreCase(entries[i].name, name)) {
+        return i;
+      }
+    }
+    return npos;
+  }
+
+  void append(uint32_t h, KnownHeader known, String&& name, String&& value) {
+    if (_size < InlineCapacity) {
+      Entry& e = _inline[_size];
+      e.hash = h;
+      e.name = std::move(name);
+      e.value = std::move(value);
+    } else {
+      if (_overflow.empty()) {  // spill all entries to the heap
+        _overflow.reserve(2 * InlineCapacity);
+        for (Entry& e : _inline) {
+          _overflow.push_back(std::move(e));
+        }
+      }
+      _overflow.push_back(Entry{h, std::move(name), std::move(value)});
+    }
+    ++_size;
+    if (known != KnownHeader::Unknown &&
+        _known[static_cast<size_t>(known)] == 0 && _size <= UINT8_MAX) {
+      _known[static_cast<size_t>(known)] = static_cast<uint8_t>(_size);
+    }
+  }
+
+ private:
+  std::array<Entry, InlineCapacity> _inline;
+  std::vector<Entry> _overflow;
+  size_t _size;
+  /// index + 1 of the first entry for every known header, 0 if absent
+  std::array<uint8_t, NumKnownHeaders> _known;
+};
+
+}}  // namespace asiodemo::rest
+
+#endif
@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "IoContext.h"
+#include "CommonHeaders.h"
+#include "Connection.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <asio/post.hpp>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace asiodemo::rest;
+
+IoContext::IoContext(unsigned id)
+    : _id(id),
+      _clients(0),
+      _connectionCount(0),
+      io_context(1),  // only one thread will ever run this context
+      _work(asio::make_work_guard(io_context)),
+      _clockTimer(io_context) {}
+
+IoContext::~IoContext() { stop(); }
+
+void IoContext::start(bool pinThread) {
+  assert(!_thread.joinable());
+  _started = std::chrono::steady_clock::now();
+  asio::post(io_context, [this]() { tickClock(); });
+  _thread = std::thread([this]() { io_context.run(); });
+
+#ifdef __linux__
+  if (pinThread) {
+    unsigned ncpus = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(_id % ncpus, &cpuset);
+    int res = pthread_setaffinity_np(_thread.native_handle(), sizeof(cpuset),
+                                     &cpuset);
+    if (res != 0) {
+      LOG_WARN("unable to pin io thread ", _id, " to cpu ", _id % ncpus, ": ",
+               res);
+    }
+  }
+#endif
+}
+
+void IoContext::addConnection(AbstrConn* conn) {
+  if (_connections.insert(conn).second) {
+    _connectionCount.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void IoContext::removeConnection(AbstrConn* conn) {
+  if (_connections.erase(conn) > 0) {
+    _connectionCount.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+void IoContext::drainConnections() {
+  // draining closes idle connections, which removes them from the set
+  std::vector<std::shared_ptr<AbstrConn>> connections;
+  connections.reserve(_connections.size());
+  for (AbstrConn* conn : _connections) {
+    connections.push_back(conn->shared_from_this());
+  }
+  for (auto& conn : connections) {
+    conn->drain();
+  }
+}
+
+void IoContext::tickClock() {
+  CommonHeaders::tick();
+
+  // catch up if the thread was busy for more than a second
+  uint64_t elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+                         std::chrono::steady_clock::now() - _started)
+                         .count();
+  while (timers.now() < elapsed) {
+    timers.tick();
+  }
+
+  // fire right after the next full second, the timer runs on the steady
+  // clock so allow for a little drift
+  auto now = std::chrono::system_clock::now().time_since_epoch();
+  auto next = std::chrono::seconds(1) + std::chrono::milliseconds(1) -
+              (now - std::chrono::duration_cast<std::chrono::seconds>(now));
+  _clockTimer.expires_after(next);
+  _clockTimer.async_wait([this](asio::error_code ec) {
+    if (!ec) {
+      tickClock();
+    }
+  });
+}
+
+void IoContext::stop() {
+  _work.reset();  // allow run() to exit
+  io_context.stop();
+  if (_thread.joinable()) {
+    _thread.join();
+  }
+}
@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef IOCONTEXT_H
+#define IOCONTEXT_H 1
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unordered_set>
+
+#include <asio/executor_work_guard.hpp>
+#include <asio/io_context.hpp>
+#include <asio/steady_timer.hpp>
+
+#include "TimerWheel.h"
+
+namespace asiodemo { namespace rest {
+
+class AbstrConn;
+
+/// An asio io_context together with the thread running it,
+/// the number of clients (sockets) currently bound to it
+/// and its open connections
+class IoContext {
+ public:
+  explicit IoContext(unsigned id);
+  ~IoContext();
+
+  IoContext(IoContext const&) = delete;
+  IoContext& operator=(IoContext const&) = delete;
+
+  unsigned id() const { return _id; }
+
+  /// start the io thread, optionally pinned to cpu (id % ncpus)
+  void start(bool pinThread);
+  /// stop the io_context and join the io thread
+  void stop();
+
+  unsigned clients() const { return _clients.load(std::memory_order_relaxed); }
+  void incClients() { _clients.fetch_add(1, std::memory_order_relaxed); }
+  void decClients() { _clients.fetch_sub(1, std::memory_order_relaxed); }
+
+  /// track an open connection, on the io thread
+  void addConnection(AbstrConn* conn);
+  void removeConnection(AbstrConn* conn);
+  /// number of open connections, may be read by any thread
+  unsigned connections() const {
+    return _connectionCount.load(std::memory_order_relaxed);
+  }
+  /// let every connection finish its current request and close it
+  /// (see AbstrConn::drain()), on the io thread
+  void drainConnections();
+
+ private:
+  /// refresh the cached Date header of the io thread and advance the
+  /// timer wheel, once a second
+  void tickClock();
+
+ private:
+  unsigned const _id;
+  std::atomic<unsigned> _clients;
+  /// only used on the io thread, the count is read by others
+  std::unordered_set<AbstrConn*> _connections;
+  std::atomic<unsigned> _connectionCount;
+
+ public:
+  /// coarse timeouts of the sockets bound to this context, only used on
+  /// the io thread. Declared before io_context: sockets destroyed with
+  /// pending handlers unlink their entries
+  TimerWheel timers;
+  asio::io_context io_context;
+
+ private:
+  asio::executor_work_guard<asio::io_context::executor_type> _work;
+  asio::steady_timer _clockTimer;
+  std::chrono::steady_clock::time_point _started;
+  std::thread _thread;
+};
+
+}}  // namespace asiodemo::rest
+
+#endif
@@ -0,0 +1,163 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "KernelTls.h"
+#include "Logger.h"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__) && __has_include(<linux/tls.h>) && \
+    OPENSSL_VERSION_NUMBER >= 0x30000000L
+#define ASIODEMO_KTLS 1
+#include <linux/tls.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <openssl/core_names.h>
+#include <openssl/kdf.h>
+#endif
+
+#ifdef ASIODEMO_KTLS
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#endif
+
+using namespace asiodemo::rest;
+
+#ifdef ASIODEMO_KTLS
+namespace {
+
+/// TLS 1.2 key block (RFC 5246 6.3) up to the server write IV
+bool keyBlock(SSL* ssl, EVP_MD const* md, unsigned char* out, size_t len) {
+  unsigned char master[SSL_MAX_MASTER_KEY_LENGTH];
+  size_t masterLen = SSL_SESSION_get_master_key(SSL_get_session(ssl), master,
+                                                sizeof(master));
+  // seed = label + server_random + client_random
+  std::string seed("key expansion");
+  size_t pos = seed.size();
+  seed.resize(pos + 2 * SSL3_RANDOM_SIZE);
+  auto* p = reinterpret_cast<unsigned char*>(&seed[pos]);
+  SSL_get_server_random(ssl, p, SSL3_RANDOM_SIZE);
+  SSL_get_client_random(ssl, p + SSL3_RANDOM_SIZE, SSL3_RANDOM_SIZE);
+
+  EVP_KDF* kdf = EVP_KDF_fetch(nullptr, OSSL_KDF_NAME_TLS1_PRF, nullptr);
+  EVP_KDF_CTX* ctx = kdf ? EVP_KDF_CTX_new(kdf) : nullptr;
+  EVP_KDF_free(kdf);
+  if (ctx == nullptr) {
+    OPENSSL_cleanse(master, sizeof(master));
+    return false;
+  }
+  OSSL_PARAM params[] = {
+      OSSL_PARAM_construct_utf8_string(
+          OSSL_KDF_PARAM_DIGEST, const_cast<char*>(EVP_MD_get0_name(md)), 0),
+      OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SECRET, master,
+                                        masterLen),
+      OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SEED, &seed[0],
+                                        seed.size()),
+      OSSL_PARAM_construct_end()};
+  bool ok = EVP_KDF_derive(ctx, out, len, params) == 1;
+  EVP_KDF_CTX_free(ctx);
+  OPENSSL_cleanse(master, sizeof(master));
+  return ok;
+}
+
+/// the kernel structs of both key sizes share their layout
+template <typename Info>
+bool configure(int fd, unsigned short cipherType, unsigned char const* key,
+               unsigned char const* salt) {
+  Info info;
+  std::memset(&info, 0, sizeof(info));
+  info.info.version = TLS_1_2_VERSION;
+  info.info.cipher_type = cipherType;
+  std::memcpy(info.key, key, sizeof(info.key));
+  std::memcpy(info.salt, salt, sizeof(info.salt));
+  // the Finished message was record 0 of the new keys
+  info.rec_seq[sizeof(info.rec_seq) - 1] = 1;
+  // explicit nonce, the kernel increments it with every record
+  std::memcpy(info.iv, info.rec_seq, sizeof(info.iv));
+  bool ok = ::setsockopt(fd, SOL_TLS, TLS_TX, &info, sizeof(info)) == 0;
+  OPENSSL_cleanse(&info, sizeof(info));
+  return ok;
+}
+
+}  // namespace
+#endif
+
+bool ktls::enableSend(SSL* ssl, int fd) {
+#ifdef ASIODEMO_KTLS
+  SSL_CIPHER const* cipher = SSL_get_current_cipher(ssl);
+  if (SSL_version(ssl) != TLS1_2_VERSION || cipher == nullptr) {
+    return false;
+  }
+  int nid = SSL_CIPHER_get_cipher_nid(cipher);
+  size_t keyLen;
+  if (nid == NID_aes_128_gcm) {
+    keyLen = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+  } else if (nid == NID_aes_256_gcm) {
+    keyLen = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+  } else {
+    return false;
+  }
+  EVP_MD const* md = SSL_CIPHER_get_handshake_digest(cipher);
+  if (md == nullptr) {
+    return false;
+  }
+
+  // the socket is only changed once the keys are known
+  constexpr size_t SaltLen = TLS_CIPHER_AES_GCM_128_SALT_SIZE;
+  unsigned char block[2 * TLS_CIPHER_AES_GCM_256_KEY_SIZE + 2 * SaltLen];
+  if (!keyBlock(ssl, md, block, 2 * keyLen + 2 * SaltLen)) {
+    LOG_DEBUG("unable to derive the TLS keys for kTLS");
+    return false;
+  }
+  // client key, server key, client IV, server IV
+  unsigned char const* key = block + keyLen;
+  unsigned char const* salt = block + 2 * keyLen + SaltLen;
+
+  // fails if the tls module is not available
+  bool ok = ::setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0;
+  if (!ok) {
+    LOG_DEBUG("kTLS not available: ", std::strerror(errno));
+  } else if (keyLen == TLS_CIPHER_AES_GCM_128_KEY_SIZE) {
+    ok = configure<tls12_crypto_info_aes_gcm_128>(
+        fd, TLS_CIPHER_AES_GCM_128, key, salt);
+  } else {
+    ok = configure<tls12_crypto_info_aes_gcm_256>(
+        fd, TLS_CIPHER_AES_GCM_256, key, salt);
+  }
+  OPENSSL_cleanse(block, sizeof(block));
+  // with the ULP but without TLS_TX the socket still sends plain data
+  return ok;
+#else
+  return false;
+#endif
+}
+
+void ktls::sendCloseNotify(int fd) {
+#ifdef ASIODEMO_KTLS
+  // alert level warning, close_notify
+  unsigned char alert[2] = {1, 0};
+  char control[CMSG_SPACE(sizeof(unsigned char))];
+  iovec iov{alert, sizeof(alert)};
+  msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_TLS;
+  cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+  *CMSG_DATA(cmsg) = 21;  // alert
+  ::sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);  // best effort
+#endif
+}
@@ -0,0 +1,27 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef KERNEL_TLS_H
+#define KERNEL_TLS_H 1
+
+#include <openssl/ssl.h>
+
+namespace asiodemo { namespace rest { namespace ktls {
+
+/// Hand the encryption of outgoing records of an established connection
+/// to the kernel (Linux kTLS, TLS_TX). Afterwards plain writes and
+/// sendfile(2) on `fd` send TLS records, `ssl` must not write anymore.
+/// Reading still uses OpenSSL.
+/// Only TLS 1.2 with AES-GCM is supported: OpenSSL does not expose the
+/// record sequence number, for TLS 1.2 it is known to be 1 after the
+/// handshake (the Finished message). Returns false if the connection or
+/// the kernel is not supported, nothing is changed then.
+bool enableSend(SSL* ssl, int fd);
+
+/// send a close_notify alert through the kernel
+void sendCloseNotify(int fd);
+
+}}}  // namespace asiodemo::rest::ktls
+
+#endif
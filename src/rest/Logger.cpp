@@ -0,0 +1,135 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Logger.h"
+
+#include <condition_variable>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace asiodemo::log;
+
+std::atomic<int> Logger::_level(static_cast<int>(LogLevel::INFO));
+std::atomic<uint64_t> Logger::_dropped(0);
+
+namespace {
+
+char const* levelName(LogLevel level) {
+  switch (level) {
+    case LogLevel::ERR:
+      return "ERROR";
+    case LogLevel::WARN:
+      return "WARN";
+    case LogLevel::INFO:
+      return "INFO";
+    case LogLevel::DEBUG:
+      return "DEBUG";
+    case LogLevel::TRACE:
+      return "TRACE";
+  }
+  return "";
+}
+
+void writePrefix(std::ostream& out, LogRecord const& record) {
+  using namespace std::chrono;
+  std::time_t secs = system_clock::to_time_t(record.time);
+  auto millis =
+      duration_cast<milliseconds>(record.time.time_since_epoch()).count() %
+      1000;
+  std::tm tm;
+  ::gmtime_r(&secs, &tm);
+  char buf[32];
+  size_t len = std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+  out.write(buf, len);
+  out << '.' << std::setw(3) << std::setfill('0') << millis << "Z "
+      << levelName(record.level) << ' ';
+}
+
+/// owns all ring buffers and the background thread writing them out
+class Flusher {
+ public:
+  Flusher() : _stop(false), _thread([this]() { run(); }) {}
+
+  ~Flusher() {
+    {
+      std::lock_guard<std::mutex> guard(_mutex);
+      _stop = true;
+    }
+    _cv.notify_one();
+    _thread.join();
+    // buffers are leaked on purpose, threads still running during
+    // static destruction may keep writing into them
+  }
+
+  LogBuffer* registerBuffer() {
+    auto* buffer = new LogBuffer();
+    std::lock_guard<std::mutex> guard(_mutex);
+    _buffers.push_back(buffer);
+    return buffer;
+  }
+
+  void flush() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    drainAll();
+  }
+
+ private:
+  void run() {
+    std::unique_lock<std::mutex> guard(_mutex);
+    while (!_stop) {
+      drainAll();
+      _cv.wait_for(guard, std::chrono::milliseconds(20));
+    }
+    drainAll();
+  }
+
+  /// must hold _mutex, it makes us the only consumer
+  void drainAll() {
+    size_t n = 0;
+    for (LogBuffer* buffer : _buffers) {
+      n += buffer->drain(std::cout);
+    }
+    if (n > 0) {
+      std::cout.flush();
+    }
+  }
+
+ private:
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::vector<LogBuffer*> _buffers;
+  bool _stop;
+  std::thread _thread;
+};
+
+Flusher& flusher() {
+  static Flusher instance;
+  return instance;
+}
+
+}  // namespace
+
+size_t LogBuffer::drain(std::ostream& out) {
+  size_t tail = _tail.load(std::memory_order_relaxed);
+  size_t head = _head.load(std::memory_order_acquire);
+  for (size_t i = tail; i != head; ++i) {
+    LogRecord& record = _records[i % Capacity];
+    writePrefix(out, record);
+    record.format(out, &record.payload);
+    out << '\n';
+  }
+  _tail.store(head, std::memory_order_release);
+  return head - tail;
+}
+
+void Logger::flush() { flusher().flush(); }
+
+LogBuffer& Logger::threadBuffer() {
+  thread_local LogBuffer* buffer = flusher().registerBuffer();
+  return *buffer;
+}
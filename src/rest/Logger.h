@@ -0,0 +1,175 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LOGGER_H
+#define LOGGER_H 1
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace asiodemo { namespace log {
+
+enum class LogLevel : int { ERR = 1, WARN = 2, INFO = 3, DEBUG = 4, TRACE = 5 };
+
+/// A log record lives in a slot of the per-thread ring buffer. It only
+/// captures the arguments, they are formatted by the flusher thread.
+struct LogRecord {
+  static constexpr size_t PayloadSize = 192;
+
+  LogLevel level;
+  std::chrono::system_clock::time_point time;
+  /// writes the payload to the stream and destroys it
+  void (*format)(std::ostream&, void*);
+  typename std::aligned_storage<PayloadSize, alignof(std::max_align_t)>::type
+      payload;
+};
+
+/// single producer / single consumer ring buffer of log records,
+/// one per logging thread, drained by the flusher thread
+class LogBuffer {
+ public:
+  static constexpr size_t Capacity = 1024;
+
+  LogBuffer() : _head(0), _tail(0) {}
+
+  /// producer: slot to fill, nullptr if the buffer is full
+  LogRecord* tryAcquire() {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) == Capacity) {
+      return nullptr;
+    }
+    return &_records[head % Capacity];
+  }
+
+  /// producer: make the slot returned by tryAcquire() visible
+  void publish() {
+    _head.store(_head.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  /// consumer: format all published records, returns their number
+  size_t drain(std::ostream&);
+
+ private:
+  alignas(64) std::atomic<size_t> _head;
+  alignas(64) std::atomic<size_t> _tail;
+  LogRecord _records[Capacity];
+};
+
+/// Type an argument is stored as until the flusher formats it. Views and
+/// C strings are copied, the memory they point to may be gone by then.
+/// String literals (const char arrays) live forever and stay pointers.
+template <typename T, typename D = typename std::decay<T>::type>
+struct LogArg {
+  typedef D type;
+  static T&& capture(T&& value) { return std::forward<T>(value); }
+};
+
+template <typename T>
+struct LogArg<T, std::string_view> {
+  typedef std::string type;
+  static type capture(std::string_view value) { return type(value); }
+};
+
+template <typename T, typename C,
+          typename A = typename std::remove_reference<T>::type>
+struct LogCString {
+  typedef typename std::conditional<
+      std::is_array<A>::value &&
+          std::is_const<typename std::remove_extent<A>::type>::value,
+      char const*, std::string>::type type;
+  static type capture(C value) { return value ? value : "(null)"; }
+};
+
+template <typename T>
+struct LogArg<T, char const*> : LogCString<T, char const*> {};
+template <typename T>
+struct LogArg<T, char*> : LogCString<T, char*> {};
+
+class Logger {
+ public:
+  static bool isEnabled(LogLevel level) {
+    return static_cast<int>(level) <= _level.load(std::memory_order_relaxed);
+  }
+  static void setLevel(LogLevel level) {
+    _level.store(static_cast<int>(level), std::memory_order_relaxed);
+  }
+
+  /// records dropped because a ring buffer was full
+  static uint64_t dropped() { return _dropped.load(std::memory_order_relaxed); }
+
+  /// wait until all records logged so far are written
+  static void flush();
+
+  template <typename... Args>
+  static void log(LogLevel level, Args&&... args) {
+    typedef std::tuple<typename LogArg<Args>::type...> Payload;
+    static_assert(sizeof(Payload) <= LogRecord::PayloadSize,
+                  "log arguments do not fit into a log record");
+    static_assert(alignof(Payload) <= alignof(std::max_align_t),
+                  "log arguments are over-aligned");
+
+    LogBuffer& buffer = threadBuffer();
+    LogRecord* record = buffer.tryAcquire();
+    if (record == nullptr) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    record->level = level;
+    record->time = std::chrono::system_clock::now();
+    record->format = &formatPayload<Payload>;
+    new (&record->payload)
+        Payload(LogArg<Args>::capture(std::forward<Args>(args))...);
+    buffer.publish();
+  }
+
+ private:
+  template <typename Tuple, size_t... I>
+  static void formatTuple(std::ostream& out, Tuple& t,
+                          std::index_sequence<I...>) {
+    using expand = int[];
+    (void)expand{0, ((void)(out << std::get<I>(t)), 0)...};
+  }
+
+  template <typename Tuple>
+  static void formatPayload(std::ostream& out, void* p) {
+    Tuple* t = static_cast<Tuple*>(p);
+    formatTuple(out, *t,
+                std::make_index_sequence<std::tuple_size<Tuple>::value>());
+    t->~Tuple();
+  }
+
+  /// ring buffer of the calling thread, registered on first use
+  static LogBuffer& threadBuffer();
+
+ private:
+  static std::atomic<int> _level;
+  static std::atomic<uint64_t> _dropped;
+};
+
+}}  // namespace asiodemo::log
+
+#define LOG_AT(level, ...)                                          \
+  do {                                                              \
+    if (::asiodemo::log::Logger::isEnabled(level)) {                \
+      ::asiodemo::log::Logger::log(level, __VA_ARGS__);             \
+    }                                                               \
+  } while (false)
+
+#define LOG_ERROR(...) LOG_AT(::asiodemo::log::LogLevel::ERR, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(::asiodemo::log::LogLevel::WARN, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(::asiodemo::log::LogLevel::INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(::asiodemo::log::LogLevel::DEBUG, __VA_ARGS__)
+#define LOG_TRACE(...) LOG_AT(::asiodemo::log::LogLevel::TRACE, __VA_ARGS__)
+
+#endif
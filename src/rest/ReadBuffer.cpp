@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ReadBuffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+using namespace asiodemo::rest;
+
+namespace {
+
+/// free list of read blocks, one per thread. A connection only ever
+/// touches its buffer on its io thread, blocks freed elsewhere (e.g. on
+/// shutdown) simply end up in that thread's list
+class BlockPool {
+ public:
+  /// bounds the memory kept by a thread after a burst
+  static constexpr size_t MaxCached = 256;
+
+  ~BlockPool() {
+    for (char* block : _free) {
+      delete[] block;
+    }
+  }
+
+  char* acquire() {
+    if (_free.empty()) {
+      return new char[ReadBuffer::BlockSize];
+    }
+    char* block = _free.back();
+    _free.pop_back();
+    return block;
+  }
+
+  void release(char* block) {
+    if (_free.size() < MaxCached) {
+      _free.push_back(block);
+    } else {
+      delete[] block;
+    }
+  }
+
+  size_t size() const { return _free.size(); }
+
+  static BlockPool& local() {
+    thread_local BlockPool pool;
+    return pool;
+  }
+
+ private:
+  std::vector<char*> _free;
+};
+
+}  // namespace
+
+asio::mutable_buffer ReadBuffer::prepare(size_t n) {
+  if (_data == nullptr) {
+    assert(_begin == 0 && _end == 0);
+    if (n <= BlockSize) {
+      _data = BlockPool::local().acquire();
+      _capacity = BlockSize;
+    } else {
+      _data = new char[n];
+      _capacity = n;
+    }
+  } else if (_capacity - _end < n) {
+    size_t used = size();
+    if (_capacity - used >= n) {
+      // enough room after dropping the consumed front
+      std::memmove(_data, _data + _begin, used);
+    } else {
+      size_t capacity = std::max(2 * _capacity, used + n);
+      char* data = new char[capacity];
+      std::memcpy(data, _data + _begin, used);
+      release();
+      _data = data;
+      _capacity = capacity;
+    }
+    _begin = 0;
+    _end = used;
+  }
+  return asio::mutable_buffer(_data + _end, n);
+}
+
+void ReadBuffer::consume(size_t n) {
+  assert(n <= size());
+  _begin += n;
+  if (_begin == _end) {
+    release();
+  }
+}
+
+void ReadBuffer::erase(size_t pos, size_t n) {
+  assert(pos + n <= size());
+  if (pos == 0) {
+    consume(n);
+    return;
+  }
+  char* p = _data + _begin + pos;
+  std::memmove(p, p + n, size() - pos - n);
+  _end -= n;
+}
+
+size_t ReadBuffer::pooledBlocks() { return BlockPool::local().size(); }
+
+void ReadBuffer::release() {
+  if (_data != nullptr) {
+    if (_capacity == BlockSize) {
+      BlockPool::local().release(_data);
+    } else {
+      delete[] _data;
+    }
+  }
+  _data = nullptr;
+  _capacity = 0;
+  _begin = 0;
+  _end = 0;
+}
@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef READ_BUFFER_H
+#define READ_BUFFER_H 1
+
+#include <cstddef>
+
+#include <asio/buffer.hpp>
+
+namespace asiodemo { namespace rest {
+
+/// Contiguous receive buffer with the interface of asio::streambuf
+/// (prepare / commit / consume). The storage is borrowed from a per-thread
+/// pool of fixed-size blocks while there are unconsumed bytes, and given
+/// back as soon as the buffer drains, so idle connections hold no memory.
+/// Messages larger than one block temporarily use a bigger heap allocation.
+class ReadBuffer {
+ public:
+  static constexpr size_t BlockSize = 1024 * 32;
+
+  ReadBuffer() : _data(nullptr), _capacity(0), _begin(0), _end(0) {}
+  ~ReadBuffer() { release(); }
+
+  ReadBuffer(ReadBuffer const&) = delete;
+  ReadBuffer& operator=(ReadBuffer const&) = delete;
+
+  /// start of the input sequence
+  char* data() const { return _data + _begin; }
+  /// size of the input sequence
+  size_t size() const { return _end - _begin; }
+  /// currently holding storage
+  bool hasStorage() const { return _data != nullptr; }
+
+  /// output sequence of exactly n bytes, may move the input sequence
+  asio::mutable_buffer prepare(size_t n);
+  /// move n bytes from the output to the input sequence
+  void commit(size_t n) { _end += n; }
+  /// remove n bytes from the front of the input sequence,
+  /// returns the storage to the pool once it is empty
+  void consume(size_t n);
+  /// remove n bytes at offset pos of the input sequence
+  void erase(size_t pos, size_t n);
+
+  /// blocks cached in the pool of the calling thread
+  static size_t pooledBlocks();
+
+ private:
+  void release();
+
+ private:
+  char* _data;
+  size_t _capacity;
+  size_t _begin;
+  size_t _end;
+};
+
+}}  // namespace asiodemo::rest
+
+#endif
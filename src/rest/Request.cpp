@@ -3,59 +3,62 @@
 using namespace asiodemo;
 using namespace asiodemo::rest;
 
-void Request::parseUrl(const char* url, size_t urlLen) {
-  this->fullUrl.reserve(urlLen);
-  // get rid of '//'
-  for (size_t i = 0; i < urlLen; ++i) {
-    this->fullUrl.push_back(url[i]);
+size_t Request::parseUrl(char* url, size_t urlLen) {
+  // get rid of '//' in the path, the url only ever shrinks
+  size_t len = 0;
+  size_t i = 0;
+  for (; i < urlLen && url[i] != '?'; ++i) {
+    url[len++] = url[i];
     if (url[i] == '/') {
       while (i + 1 < urlLen && url[i + 1] == '/') {
         ++i;
       }
     }
   }
-
-  const char* start = this->fullUrl.data();
-  const char* end = start + this->fullUrl.size();
-
-  char const* q = start;
-  while (q != end && *q != '?') {
-    ++q;
+  for (; i < urlLen; ++i) {
+    url[len++] = url[i];
   }
 
-  if (q == end || *q == '?') {
-    this->path.assign(start, q - start);
-  }
-  if (q == end) {
-    return;
-  }
+  this->fullUrl = std::string_view(url, len);
+  size_t q = this->fullUrl.find('?');
+  this->path = this->fullUrl.substr(0, q);
 
-  bool keyPhase = true;
-  const char* keyBegin = ++q;
-  const char* keyEnd = keyBegin;
-  const char* valueBegin = nullptr;
+  this->params.clear();
+  if (q == std::string_view::npos) {
+    return len;
+  }
 
-  while (q != end) {
-    if (keyPhase) {
-      keyEnd = q;
-      if (*q == '=') {
-        keyPhase = false;
-        valueBegin = q + 1;
+  std::string_view query = this->fullUrl.substr(q + 1);
+  while (!query.empty()) {
+    size_t amp = query.find('&');
+    std::string_view pair = query.substr(0, amp);
+    if (!pair.empty()) {
+      size_t eq = pair.find('=');
+      std::string_view value;
+      if (eq != std::string_view::npos) {
+        value = pair.substr(eq + 1);
       }
-      ++q;
-      continue;
+      this->params.emplace_back(pair.substr(0, eq), value);
     }
-
-    if (q + 1 == end || *(q + 1) == '&') {
-      ++q;  // skip ahead
-
-      std::string val = std::string(valueBegin, q - valueBegin);
-      params[std::string(keyBegin, keyEnd - keyBegin)] = std::move(val);
-
-      keyPhase = true;
-      keyBegin = q + 1;
-      continue;
+    if (amp == std::string_view::npos) {
+      break;
     }
-    ++q;
+    query.remove_prefix(amp + 1);
+  }
+  return len;
+}
+
+void Request::clear() {
+  method = Type::ILLEGAL;
+  fullUrl = std::string_view();
+  path = std::string_view();
+  params.clear();
+  pathParams.clear();
+  headers.clear();
+  if (body.capacity() > MaxRetainedBody) {
+    // one large upload must not pin its buffer for the connection lifetime
+    std::string().swap(body);
+  } else {
+    body.clear();
   }
-}
\ No newline at end of file
+}
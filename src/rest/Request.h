@@ -2,11 +2,59 @@
 #ifndef REQUEST_H
 #define REQUEST_H 1
 
-#include <map>
+#include <array>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include "Headers.h"
 
 namespace asiodemo { namespace rest {
 
+/// parameters captured by the router, e.g. `id` for `/users/:id`.
+/// Names and values are views into the route and Request::path
+class PathParams {
+ public:
+  static constexpr size_t MaxParams = 8;
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+  void clear() { _size = 0; }
+
+  /// returns false if there is no space left
+  bool add(std::string_view name, std::string_view value) {
+    if (_size == MaxParams) {
+      return false;
+    }
+    _params[_size++] = {name, value};
+    return true;
+  }
+  /// forget all params added after `size`
+  void truncate(size_t size) { _size = size; }
+
+  std::string_view get(std::string_view name, bool& found) const {
+    for (size_t i = 0; i < _size; ++i) {
+      if (_params[i].first == name) {
+        found = true;
+        return _params[i].second;
+      }
+    }
+    found = false;
+    return std::string_view();
+  }
+
+  std::pair<std::string_view, std::string_view> const* begin() const {
+    return _params.data();
+  }
+  std::pair<std::string_view, std::string_view> const* end() const {
+    return _params.data() + _size;
+  }
+
+ private:
+  std::array<std::pair<std::string_view, std::string_view>, MaxParams> _params;
+  size_t _size = 0;
+};
+
 struct Request {
   enum class Type {
     DELETE_REQ = 0,  // windows redefines DELETE
@@ -19,33 +67,59 @@ struct Request {
     ILLEGAL  // must be last
   };
 
-  void parseUrl(const char* path, size_t len);
+  typedef std::vector<std::pair<std::string_view, std::string_view>> Views;
 
-  std::string header(std::string const& key) const {
-    bool found;
-    return this->header(key, found);
+  /// parse the url in place ('//' in the path are collapsed),
+  /// returns the new length of the url
+  size_t parseUrl(char* url, size_t len);
+
+  /// body capacity kept by clear() for the next request
+  static constexpr size_t MaxRetainedBody = 16 * 1024;
+
+  /// forget everything, but keep allocated memory for the next request
+  /// (the body only up to MaxRetainedBody)
+  void clear();
+
+  /// header value, case-insensitive
+  std::string_view header(std::string_view key) const {
+    return headers.get(key);
+  }
+  std::string_view header(std::string_view key, bool& found) const {
+    return headers.get(key, found);
+  }
+  std::string_view header(KnownHeader key, bool& found) const {
+    return headers.get(key, found);
   }
-  std::string header(std::string const& key, bool& found) const {
-    auto const& val = headers.find(key);
-    if (val != headers.end()) {
-      found = true;
-      return val->second;
+
+  /// query parameter
+  std::string_view param(std::string_view key, bool& found) const {
+    for (auto const& it : params) {
+      if (it.first == key) {
+        found = true;
+        return it.second;
+      }
     }
     found = false;
-    return std::string();
+    return std::string_view();
   }
 
-  void setHeader(std::string key, std::string val) {
-    headers.emplace(std::move(key), std::move(val));
+  /// path parameter captured by the router
+  std::string_view pathParam(std::string_view name) const {
+    bool found;
+    return pathParams.get(name, found);
   }
 
  public:
+  // url, path, params and headers are views into the receive buffer of
+  // the connection, they stay valid until the response is sent
+
   Type method;
-  std::string fullUrl;  // path as specified
-  std::string path;     // path without query
-  std::map<std::string, std::string> params;
+  std::string_view fullUrl;  // url as specified, minus '//' in the path
+  std::string_view path;     // path without query
+  Views params;
+  PathParams pathParams;
 
-  std::map<std::string, std::string> headers;
+  HeaderMap<std::string_view> headers;  // header names are lower case
   std::string body;
 };
 }}  // namespace asiodemo::rest
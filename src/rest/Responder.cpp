@@ -0,0 +1,42 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Responder.h"
+#include "Connection.h"
+
+using namespace asiodemo::rest;
+
+Responder::Responder(std::shared_ptr<AbstrConn> conn)
+    : _conn(std::move(conn)) {}
+
+Responder::~Responder() { sendServerError(); }
+
+Responder& Responder::operator=(Responder&& other) {
+  if (this != &other) {
+    sendServerError();
+    _conn = std::move(other._conn);
+  }
+  return *this;
+}
+
+void BodyControl::resume() const {
+  if (_conn) {
+    _conn->resumeBody();
+  }
+}
+
+void Responder::send(std::unique_ptr<Response> response) {
+  if (_conn) {
+    AbstrConn* conn = _conn.get();
+    conn->postResponse(std::move(_conn), std::move(response));
+  }
+}
+
+void Responder::sendServerError() {
+  if (_conn) {
+    auto response = std::make_unique<Response>();
+    response->status_code = ResponseCode::SERVER_ERROR;
+    send(std::move(response));
+  }
+}
@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef RESPONDER_H
+#define RESPONDER_H 1
+
+#include <memory>
+#include <string_view>
+
+#include "Response.h"
+
+namespace asiodemo { namespace rest {
+
+class AbstrConn;
+
+/// Completes a request answered by an asynchronous handler. It may be
+/// moved to and used on any thread, the response is posted back to the io
+/// thread of the connection. A responder destroyed without sending
+/// answers with 500, so a connection is never left waiting.
+class Responder {
+ public:
+  explicit Responder(std::shared_ptr<AbstrConn> conn);
+  ~Responder();
+
+  Responder(Responder&&) = default;
+  /// a pending request of this responder is answered with 500 first
+  Responder& operator=(Responder&&);
+  Responder(Responder const&) = delete;
+  Responder& operator=(Responder const&) = delete;
+
+  /// send the response, only the first call has an effect
+  void send(std::unique_ptr<Response> response);
+
+ private:
+  void sendServerError();
+
+ private:
+  std::shared_ptr<AbstrConn> _conn;
+};
+
+/// Flow control of a streamed request body, may be copied to and used on
+/// any thread. Keeps the connection alive while reading is paused, the
+/// connection drops its consumer (and the control it holds) when closed.
+class BodyControl {
+ public:
+  explicit BodyControl(std::shared_ptr<AbstrConn> conn)
+      : _conn(std::move(conn)) {}
+
+  /// deliver further chunks after BodyConsumer::onData() returned false
+  void resume() const;
+
+ private:
+  std::shared_ptr<AbstrConn> _conn;
+};
+
+/// Receives the body of a request in chunks as they arrive, so memory per
+/// upload is bounded by the read block size instead of Content-Length.
+/// Created by a streaming handler once the request header is complete,
+/// all calls happen on the io thread of the connection.
+class BodyConsumer {
+ public:
+  virtual ~BodyConsumer() = default;
+
+  /// the next chunk, only valid during the call. Return false to stop
+  /// reading from the socket until BodyControl::resume() is called
+  virtual bool onData(std::string_view chunk) = 0;
+
+  /// the body is complete, answer the request now or later
+  virtual void onComplete(Responder responder) = 0;
+};
+
+}}  // namespace asiodemo::rest
+
+#endif
@@ -1,209 +1,232 @@
 #include "Response.h"
+#include "CommonHeaders.h"
+#include "Utils.h"
+
+#include <array>
+#include <cassert>
+#include <cstring>
 
 using namespace asiodemo;
 using namespace asiodemo::rest;
 
-std::string Response::responseString() const {
-  switch (this->status_code) {
-    //  Informational 1xx
-    case ResponseCode::CONTINUE:
-      return "100 Continue";
-    case ResponseCode::SWITCHING_PROTOCOLS:
-      return "101 Switching Protocols";
-    case ResponseCode::PROCESSING:
-      return "102 Processing";
-
-    //  Success 2xx
-    case ResponseCode::OK:
-      return "200 OK";
-    case ResponseCode::CREATED:
-      return "201 Created";
-    case ResponseCode::ACCEPTED:
-      return "202 Accepted";
-    case ResponseCode::PARTIAL:
-      return "203 Non-Authoritative Information";
-    case ResponseCode::NO_CONTENT:
-      return "204 No Content";
-    case ResponseCode::RESET_CONTENT:
-      return "205 Reset Content";
-    case ResponseCode::PARTIAL_CONTENT:
-      return "206 Partial Content";
-
-    //  Redirection 3xx
-    case ResponseCode::MOVED_PERMANENTLY:
-      return "301 Moved Permanently";
-    case ResponseCode::FOUND:
-      return "302 Found";
-    case ResponseCode::SEE_OTHER:
-      return "303 See Other";
-    case ResponseCode::NOT_MODIFIED:
-      return "304 Not Modified";
-    case ResponseCode::TEMPORARY_REDIRECT:
-      return "307 Temporary Redirect";
-    case ResponseCode::PERMANENT_REDIRECT:
-      return "308 Permanent Redirect";
-
-    //  Client Error 4xx
-    case ResponseCode::BAD:
-      return "400 Bad Request";
-    case ResponseCode::UNAUTHORIZED:
-      return "401 Unauthorized";
-    case ResponseCode::PAYMENT_REQUIRED:
-      return "402 Payment Required";
-    case ResponseCode::FORBIDDEN:
-      return "403 Forbidden";
-    case ResponseCode::NOT_FOUND:
-      return "404 Not Found";
-    case ResponseCode::METHOD_NOT_ALLOWED:
-      return "405 Method Not Allowed";
-    case ResponseCode::NOT_ACCEPTABLE:
-      return "406 Not Acceptable";
-    case ResponseCode::REQUEST_TIMEOUT:
-      return "408 Request Timeout";
-    case ResponseCode::CONFLICT:
-      return "409 Conflict";
-    case ResponseCode::GONE:
-      return "410 Gone";
-    case ResponseCode::LENGTH_REQUIRED:
-      return "411 Length Required";
-    case ResponseCode::PRECONDITION_FAILED:
-      return "412 Precondition Failed";
-    case ResponseCode::REQUEST_ENTITY_TOO_LARGE:
-      return "413 Payload Too Large";
-    case ResponseCode::REQUEST_URI_TOO_LONG:
-      return "414 Request-URI Too Long";
-    case ResponseCode::UNSUPPORTED_MEDIA_TYPE:
-      return "415 Unsupported Media Type";
-    case ResponseCode::REQUESTED_RANGE_NOT_SATISFIABLE:
-      return "416 Requested Range Not Satisfiable";
-    case ResponseCode::EXPECTATION_FAILED:
-      return "417 Expectation Failed";
-    case ResponseCode::I_AM_A_TEAPOT:
-      return "418 I'm a teapot";
-    case ResponseCode::UNPROCESSABLE_ENTITY:
-      return "422 Unprocessable Entity";
-    case ResponseCode::LOCKED:
-      return "423 Locked";
-    case ResponseCode::PRECONDITION_REQUIRED:
-      return "428 Precondition Required";
-    case ResponseCode::TOO_MANY_REQUESTS:
-      return "429 Too Many Requests";
-    case ResponseCode::REQUEST_HEADER_FIELDS_TOO_LARGE:
-      return "431 Request Header Fields Too Large";
-    case ResponseCode::UNAVAILABLE_FOR_LEGAL_REASONS:
-      return "451 Unavailable For Legal Reasons";
-
-    //  Server Error 5xx
-    case ResponseCode::SERVER_ERROR:
-      return "500 Internal Server Error";
-    case ResponseCode::NOT_IMPLEMENTED:
-      return "501 Not Implemented";
-    case ResponseCode::BAD_GATEWAY:
-      return "502 Bad Gateway";
-    case ResponseCode::SERVICE_UNAVAILABLE:
-      return "503 Service Unavailable";
-    case ResponseCode::HTTP_VERSION_NOT_SUPPORTED:
-      return "505 HTTP Version Not Supported";
-    case ResponseCode::BANDWIDTH_LIMIT_EXCEEDED:
-      return "509 Bandwidth Limit Exceeded";
-    case ResponseCode::NOT_EXTENDED:
-      return "510 Not Extended";
-
-    // default
-    default: {
-      auto code = status_code;
-      // print generic group responses, based on error code group
-      int group = ((int)code) / 100;
-      switch (group) {
-        case 1:
-          return std::to_string((int)code) + " Informational";
-        case 2:
-          return std::to_string((int)code) + " Success";
-        case 3:
-          return std::to_string((int)code) + " Redirection";
-        case 4:
-          return std::to_string((int)code) + " Client error";
-        case 5:
-          return std::to_string((int)code) + " Server error";
-        default:
-          break;
-      }
+namespace {
+
+/// complete status lines, indexed by status code
+struct StatusLineTable {
+  std::array<std::string_view, 600> lines;
+
+  constexpr StatusLineTable() : lines() {
+    lines[100] = "HTTP/1.1 100 Continue\r\n";
+    lines[101] = "HTTP/1.1 101 Switching Protocols\r\n";
+    lines[102] = "HTTP/1.1 102 Processing\r\n";
+    lines[200] = "HTTP/1.1 200 OK\r\n";
+    lines[201] = "HTTP/1.1 201 Created\r\n";
+    lines[202] = "HTTP/1.1 202 Accepted\r\n";
+    lines[203] = "HTTP/1.1 203 Non-Authoritative Information\r\n";
+    lines[204] = "HTTP/1.1 204 No Content\r\n";
+    lines[205] = "HTTP/1.1 205 Reset Content\r\n";
+    lines[206] = "HTTP/1.1 206 Partial Content\r\n";
+    lines[301] = "HTTP/1.1 301 Moved Permanently\r\n";
+    lines[302] = "HTTP/1.1 302 Found\r\n";
+    lines[303] = "HTTP/1.1 303 See Other\r\n";
+    lines[304] = "HTTP/1.1 304 Not Modified\r\n";
+    lines[307] = "HTTP/1.1 307 Temporary Redirect\r\n";
+    lines[308] = "HTTP/1.1 308 Permanent Redirect\r\n";
+    lines[400] = "HTTP/1.1 400 Bad Request\r\n";
+    lines[401] = "HTTP/1.1 401 Unauthorized\r\n";
+    lines[402] = "HTTP/1.1 402 Payment Required\r\n";
+    lines[403] = "HTTP/1.1 403 Forbidden\r\n";
+    lines[404] = "HTTP/1.1 404 Not Found\r\n";
+    lines[405] = "HTTP/1.1 405 Method Not Allowed\r\n";
+    lines[406] = "HTTP/1.1 406 Not Acceptable\r\n";
+    lines[408] = "HTTP/1.1 408 Request Timeout\r\n";
+    lines[409] = "HTTP/1.1 409 Conflict\r\n";
+    lines[410] = "HTTP/1.1 410 Gone\r\n";
+    lines[411] = "HTTP/1.1 411 Length Required\r\n";
+    lines[412] = "HTTP/1.1 412 Precondition Failed\r\n";
+    lines[413] = "HTTP/1.1 413 Payload Too Large\r\n";
+    lines[414] = "HTTP/1.1 414 Request-URI Too Long\r\n";
+    lines[415] = "HTTP/1.1 415 Unsupported Media Type\r\n";
+    lines[416] = "HTTP/1.1 416 Requested Range Not Satisfiable\r\n";
+    lines[417] = "HTTP/1.1 417 Expectation Failed\r\n";
+    lines[418] = "HTTP/1.1 418 I'm a teapot\r\n";
+    lines[422] = "HTTP/1.1 422 Unprocessable Entity\r\n";
+    lines[423] = "HTTP/1.1 423 Locked\r\n";
+    lines[428] = "HTTP/1.1 428 Precondition Required\r\n";
+    lines[429] = "HTTP/1.1 429 Too Many Requests\r\n";
+    lines[431] = "HTTP/1.1 431 Request Header Fields Too Large\r\n";
+    lines[451] = "HTTP/1.1 451 Unavailable For Legal Reasons\r\n";
+    lines[500] = "HTTP/1.1 500 Internal Server Error\r\n";
+    lines[501] = "HTTP/1.1 501 Not Implemented\r\n";
+    lines[502] = "HTTP/1.1 502 Bad Gateway\r\n";
+    lines[503] = "HTTP/1.1 503 Service Unavailable\r\n";
+    lines[505] = "HTTP/1.1 505 HTTP Version Not Supported\r\n";
+    lines[509] = "HTTP/1.1 509 Bandwidth Limit Exceeded\r\n";
+    lines[510] = "HTTP/1.1 510 Not Extended\r\n";
+  }
+};
+constexpr StatusLineTable statusLines;
+
+/// response header names of the well-known headers, indexed by KnownHeader
+constexpr std::array<std::string_view, NumKnownHeaders> canonicalNames = {
+    {"Content-Length", "Connection", "Host", "Origin", "Expect",
+     "Accept-Encoding", "Content-Type", "Transfer-Encoding", "ETag"}};
+
+/// lookup tables for the capitalization of header names
+struct CaseTable {
+  char upper[256];
+  char lower[256];
+
+  constexpr CaseTable() : upper(), lower() {
+    for (int c = 0; c < 256; ++c) {
+      upper[c] = static_cast<char>((c >= 'a' && c <= 'z') ? c - 32 : c);
+      lower[c] = static_cast<char>((c >= 'A' && c <= 'Z') ? c + 32 : c);
     }
   }
+};
+constexpr CaseTable caseTable;
 
-  return std::to_string((int)status_code) + " Unknown";
-}
+constexpr std::string_view SetCookie = "Set-Cookie: ";
+constexpr std::string_view ContentLength = "Content-Length: ";
+constexpr std::string_view Chunked = "Transfer-Encoding: chunked\r\n";
 
-std::unique_ptr<std::string> Response::generateHeader() const {
-  // TODO lease buffers
-  auto header = std::make_unique<std::string>();
-  header->reserve(220);
+inline char* append(char* out, std::string_view str) {
+  std::memcpy(out, str.data(), str.size());
+  return out + str.size();
+}
 
-  header->append("HTTP/1.1 ");
-  header->append(this->responseString());
-  header->append("\r\n", 2);
+inline char* appendCrLf(char* out) {
+  out[0] = '\r';
+  out[1] = '\n';
+  return out + 2;
+}
 
-  for (auto const& it : this->headers) {
-    std::string const& key = it.first;
-    size_t const keyLength = key.size();
-    // ignore content-length
-    if (key == "content-length" || key == "connection" ||
-        key == "transfer-encoding") {
-      continue;
+/// "Content-Type" style capitalization: upper case at the start and
+/// after every '-', lower case everywhere else, as is after a ':'
+inline char* appendCapitalized(char* out, std::string_view name) {
+  char const* p = name.data();
+  char const* end = p + name.size();
+  char const* table = caseTable.upper;
+  while (p < end) {
+    char c = *p++;
+    *out++ = table[static_cast<unsigned char>(c)];
+    if (c == ':') {
+      size_t rest = end - p;
+      std::memcpy(out, p, rest);
+      return out + rest;
     }
+    table = (c == '-') ? caseTable.upper : caseTable.lower;
+  }
+  return out;
+}
 
-    // reserve enough space for header name + ": " + value + "\r\n"
-    header->reserve(key.size() + 2 + it.second.size() + 2);
-
-    char const* p = key.data();
-    char const* end = p + keyLength;
-    int capState = 1;
-    while (p < end) {
-      if (capState == 1) {
-        // upper case
-        header->push_back(::toupper(*p));
-        capState = 0;
-      } else if (capState == 0) {
-        // normal case
-        header->push_back(::tolower(*p));
-        if (*p == '-') {
-          capState = 1;
-        } else if (*p == ':') {
-          capState = 2;
-        }
-      } else {
-        // output as is
-        header->push_back(*p);
-      }
-      ++p;
-    }
+char const* groupName(int code) {
+  switch (code / 100) {
+    case 1:
+      return "Informational";
+    case 2:
+      return "Success";
+    case 3:
+      return "Redirection";
+    case 4:
+      return "Client error";
+    case 5:
+      return "Server error";
+    default:
+      return "Unknown";
+  }
+}
+
+}  // namespace
+
+std::string_view Response::statusLine(ResponseCode code) {
+  size_t i = static_cast<size_t>(code);
+  return i < statusLines.lines.size() ? statusLines.lines[i]
+                                      : std::string_view();
+}
+
+std::string Response::responseString() const {
+  std::string_view line = statusLine(this->status_code);
+  if (!line.empty()) {
+    // strip "HTTP/1.1 " and "\r\n"
+    return std::string(line.substr(9, line.size() - 11));
+  }
+  // print generic group responses, based on error code group
+  int code = static_cast<int>(this->status_code);
+  return std::to_string(code) + " " + groupName(code);
+}
+
+void Response::writeHeader(std::string& out, bool keepAlive) const {
+  std::string_view status = statusLine(this->status_code);
+  std::string generic;
+  if (status.empty()) {
+    generic = "HTTP/1.1 " + responseString() + "\r\n";
+    status = generic;
+  }
 
-    header->append(": ", 2);
-    header->append(it.second);
-    header->append("\r\n", 2);
+  // Content-Type, Date, Connection and Keep-Alive, preformatted
+  std::string_view common =
+      this->headers.contains(KnownHeader::ContentType)
+          ? CommonHeaders::blockWithoutContentType(keepAlive)
+          : CommonHeaders::block(keepAlive);
+
+  // upper bound of the header size, the buffer is shrunk afterwards
+  size_t bound = status.size() + ContentLength.size() + 20 + 2 + common.size();
+  for (auto const& it : this->headers) {
+    bound += it.name.size() + 2 + it.value.size() + 2;
+  }
+  for (auto const& it : this->cookies) {
+    bound += SetCookie.size() + it.size() + 2;
   }
 
-  // add "Content-Type" header
-  header->append("Content-Type: text/plain; charset=utf-8\r\n");
+  size_t const offset = out.size();
+  out.resize(offset + bound);
+  char* const start = &out[offset];
+  char* p = append(start, status);
+
+  for (auto const& it : this->headers) {
+    KnownHeader known = headers::classify(it.hash, it.name);
+    if (known == KnownHeader::ContentLength ||
+        known == KnownHeader::Connection ||
+        known == KnownHeader::TransferEncoding) {
+      continue;  // generated below
+    }
+    if (known != KnownHeader::Unknown) {
+      p = append(p, canonicalNames[static_cast<size_t>(known)]);
+    } else {
+      p = appendCapitalized(p, it.name);
+    }
+    *p++ = ':';
+    *p++ = ' ';
+    p = append(p, it.value);
+    p = appendCrLf(p);
+  }
 
   // Cookies
   for (auto const& it : this->cookies) {
-    header->append("Set-Cookie: ");
-    header->append(it);
-    header->append("\r\n", 2);
+    p = append(p, SetCookie);
+    p = append(p, it);
+    p = appendCrLf(p);
   }
 
-  header->append("Content-Length: ");
-  if (this->body) {
-    header->append(std::to_string(this->body->size()));
+  if (this->producer) {
+    p = append(p, Chunked);
   } else {
-    header->append("0");
+    p = append(p, ContentLength);
+    uint64_t length = this->file ? this->fileLength
+                                 : (this->body ? this->body->size() : 0);
+    p += utils::formatUInt(length, p);
+    p = appendCrLf(p);
   }
-  header->append("\r\n", 2);
 
-  header->append("Connection: Keep-Alive\r\n");
-  header->append("Keep-Alive: timeout=60");
-  header->append("\r\n\r\n");
+  p = append(p, common);
 
+  assert(static_cast<size_t>(p - start) <= bound);
+  out.resize(offset + (p - start));
+}
+
+std::unique_ptr<std::string> Response::generateHeader() const {
+  auto header = std::make_unique<std::string>();
+  writeHeader(*header);
   return header;
 }
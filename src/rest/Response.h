@@ -2,10 +2,14 @@
 #ifndef RESPONSE_H
 #define RESPONSE_H 1
 
-#include <map>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "Headers.h"
+
 namespace asiodemo { namespace rest {
 
 enum class ResponseCode {
@@ -62,21 +66,45 @@ enum class ResponseCode {
   NOT_EXTENDED = 510
 };
 
+struct StaticFile;
+
+/// Produces a response body piece by piece, it is sent with
+/// Transfer-Encoding: chunked. produce() is called on the io thread of the
+/// connection whenever the previous piece was written to the socket, so a
+/// slow client slows down the producer.
+class BodyProducer {
+ public:
+  virtual ~BodyProducer() = default;
+
+  /// append the next piece of the body to `out`, return false if it was
+  /// the last one
+  virtual bool produce(std::string& out) = 0;
+};
+
 struct Response {
   ResponseCode status_code;
-  std::map<std::string, std::string> headers;
+  HeaderMap<std::string> headers;
   std::vector<std::string> cookies;
   std::unique_ptr<std::string> body;
+  /// streamed body, used instead of `body` if set
+  std::unique_ptr<BodyProducer> producer;
+  /// range of an open file sent as the body (sendfile(2) on plain tcp),
+  /// used instead of `body` if set
+  std::shared_ptr<StaticFile const> file;
+  uint64_t fileOffset = 0;
+  uint64_t fileLength = 0;
 
-  void setHeaderNCIfNotSet(std::string const& key, std::string const& value) {
-    if (headers.find(key) != headers.end()) {
-      // already set
-      return;
-    }
-    headers.emplace(key, value);
+  void setHeaderNCIfNotSet(std::string_view key, std::string value) {
+    headers.setIfNotSet(key, std::move(value));
   }
 
+  /// "HTTP/1.1 200 OK\r\n", empty for codes without a known reason phrase
+  static std::string_view statusLine(ResponseCode);
+
   std::string responseString() const;
+  /// serialize the response header and append it to `out`, without
+  /// `keepAlive` it announces the end of the connection
+  void writeHeader(std::string& out, bool keepAlive = true) const;
   std::unique_ptr<std::string> generateHeader() const;
 };
 }}  // namespace asiodemo::rest
@@ -0,0 +1,266 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Router.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+using namespace asiodemo;
+using namespace asiodemo::rest;
+
+namespace {
+constexpr size_t NumMethods = static_cast<size_t>(Request::Type::ILLEGAL) + 1;
+
+size_t methodIndex(Request::Type type) { return static_cast<size_t>(type); }
+
+/// first segment of a path without leading slash
+std::string_view firstSegment(std::string_view path) {
+  return path.substr(0, path.find('/'));
+}
+
+/// the path after the first segment (and its slash)
+std::string_view skipSegment(std::string_view path, size_t len) {
+  return path.substr(std::min(len + 1, path.size()));
+}
+
+std::string_view trimSlashes(std::string_view path) {
+  while (!path.empty() && path.front() == '/') {
+    path.remove_prefix(1);
+  }
+  while (!path.empty() && path.back() == '/') {
+    path.remove_suffix(1);
+  }
+  return path;
+}
+
+std::vector<std::string_view> splitSegments(std::string_view path) {
+  std::vector<std::string_view> segs;
+  while (!path.empty()) {
+    std::string_view seg = firstSegment(path);
+    if (!seg.empty()) {  // ignore '//'
+      segs.push_back(seg);
+    }
+    path = skipSegment(path, seg.size());
+  }
+  return segs;
+}
+
+std::string joinSegments(std::vector<std::string_view>::const_iterator begin,
+                         std::vector<std::string_view>::const_iterator end) {
+  std::string result;
+  for (auto it = begin; it != end; ++it) {
+    if (it != begin) {
+      result.push_back('/');
+    }
+    result.append(it->data(), it->size());
+  }
+  return result;
+}
+
+bool isStatic(std::string_view seg) { return seg[0] != ':' && seg[0] != '*'; }
+}  // namespace
+
+struct Router::Node {
+  /// one or more static segments joined by '/', empty for the root
+  std::string label;
+  /// static children, sorted by the first segment of their label
+  std::vector<std::unique_ptr<Node>> children;
+  /// first segments of the children's labels, in the same order. Kept
+  /// apart so the binary search does not touch the children
+  std::vector<std::string> childKeys;
+  /// `:name` child
+  std::unique_ptr<Node> param;
+  std::string paramName;
+  /// `*name` child, always a leaf
+  std::unique_ptr<Node> wildcard;
+  std::string wildcardName;
+
+  std::array<Route, NumMethods> routes;
+  bool hasRoutes = false;
+
+  /// index of the first child whose key is not less than `seg`
+  size_t lowerBound(std::string_view seg) const {
+    return std::lower_bound(childKeys.begin(), childKeys.end(), seg,
+                            [](std::string const& key, std::string_view s) {
+                              return key < s;
+                            }) -
+           childKeys.begin();
+  }
+
+  /// static child whose label starts with segment `seg`
+  Node* child(std::string_view seg) const {
+    size_t i = lowerBound(seg);
+    if (i < childKeys.size() && childKeys[i] == seg) {
+      return children[i].get();
+    }
+    return nullptr;
+  }
+};
+
+Router::Router() : _root(std::make_unique<Node>()) {}
+
+Router::~Router() {}
+
+void Router::add(Request::Type method, std::string_view path, Route route) {
+  std::vector<std::string_view> segs = splitSegments(trimSlashes(path));
+  insert(_root.get(), segs, 0, method, std::move(route));
+}
+
+void Router::insert(Node* node, std::vector<std::string_view> const& segs,
+                    size_t pos, Request::Type method, Route&& route) {
+  if (pos == segs.size()) {
+    Route& slot = node->routes[methodIndex(method)];
+    if (!slot.empty()) {
+      throw std::invalid_argument("duplicate route");
+    }
+    slot = std::move(route);
+    node->hasRoutes = true;
+    return;
+  }
+
+  std::string_view seg = segs[pos];
+  if (seg[0] == ':') {
+    std::string_view name = seg.substr(1);
+    if (!node->param) {
+      node->param = std::make_unique<Node>();
+      node->param->label.assign(seg.data(), seg.size());
+      node->paramName.assign(name.data(), name.size());
+    } else if (node->paramName != name) {
+      throw std::invalid_argument("conflicting path parameter names");
+    }
+    insert(node->param.get(), segs, pos + 1, method, std::move(route));
+    return;
+  }
+
+  if (seg[0] == '*') {
+    if (pos + 1 != segs.size()) {
+      throw std::invalid_argument("catch-all must be the last path segment");
+    }
+    std::string_view name = seg.substr(1);
+    if (!node->wildcard) {
+      node->wildcard = std::make_unique<Node>();
+      node->wildcard->label.assign(seg.data(), seg.size());
+      node->wildcardName.assign(name.data(), name.size());
+    } else if (node->wildcardName != name) {
+      throw std::invalid_argument("conflicting catch-all names");
+    }
+    insert(node->wildcard.get(), segs, pos + 1, method, std::move(route));
+    return;
+  }
+
+  // run of static segments, stored compressed in one edge
+  size_t end = pos;
+  while (end < segs.size() && isStatic(segs[end])) {
+    ++end;
+  }
+
+  Node* child = node->child(seg);
+  if (child == nullptr) {
+    auto n = std::make_unique<Node>();
+    n->label = joinSegments(segs.begin() + pos, segs.begin() + end);
+    child = n.get();
+    size_t i = node->lowerBound(seg);
+    node->childKeys.emplace(node->childKeys.begin() + i, seg);
+    node->children.emplace(node->children.begin() + i, std::move(n));
+    insert(child, segs, end, method, std::move(route));
+    return;
+  }
+
+  // number of leading segments shared with the existing edge
+  std::vector<std::string_view> labelSegs = splitSegments(child->label);
+  size_t common = 0;
+  while (common < labelSegs.size() && pos + common < end &&
+         labelSegs[common] == segs[pos + common]) {
+    ++common;
+  }
+  assert(common > 0);
+
+  if (common < labelSegs.size()) {
+    // split the edge, the shared prefix becomes a new intermediate node
+    auto mid = std::make_unique<Node>();
+    mid->label = joinSegments(labelSegs.begin(), labelSegs.begin() + common);
+    std::string rest =
+        joinSegments(labelSegs.begin() + common, labelSegs.end());
+
+    auto it = node->children.begin() + node->lowerBound(seg);
+    std::unique_ptr<Node> old = std::move(*it);
+    old->label = std::move(rest);
+    mid->childKeys.emplace_back(firstSegment(old->label));
+    mid->children.push_back(std::move(old));
+    child = mid.get();
+    *it = std::move(mid);  // same first segment, order is preserved
+  }
+  insert(child, segs, pos + common, method, std::move(route));
+}
+
+Router::Node const* Router::lookup(Node const* node, std::string_view rest,
+                                   PathParams& params) {
+  if (rest.empty() && node->hasRoutes) {
+    return node;
+  }
+
+  if (!rest.empty()) {
+    std::string_view seg = firstSegment(rest);
+
+    // static edges first
+    Node const* child = node->child(seg);
+    if (child != nullptr) {
+      std::string_view label = child->label;
+      if (rest.compare(0, label.size(), label) == 0 &&
+          (rest.size() == label.size() || rest[label.size()] == '/')) {
+        Node const* found =
+            lookup(child, skipSegment(rest, label.size()), params);
+        if (found != nullptr) {
+          return found;
+        }
+      }
+    }
+
+    // then a parameter capturing this segment
+    if (node->param && !seg.empty()) {
+      size_t mark = params.size();
+      if (params.add(node->paramName, seg)) {
+        Node const* found =
+            lookup(node->param.get(), skipSegment(rest, seg.size()), params);
+        if (found != nullptr) {
+          return found;
+        }
+        params.truncate(mark);  // backtrack
+      }
+    }
+  }
+
+  // finally the catch-all
+  if (node->wildcard && node->wildcard->hasRoutes &&
+      params.add(node->wildcardName, rest)) {
+    return node->wildcard.get();
+  }
+  return nullptr;
+}
+
+Route const* Router::find(Request& req, Match& match) const {
+  req.pathParams.clear();
+  Node const* node = lookup(_root.get(), trimSlashes(req.path), req.pathParams);
+  if (node == nullptr) {
+    match = Match::NotFound;
+    return nullptr;
+  }
+
+  Route const* route = &node->routes[methodIndex(req.method)];
+  if (route->empty() && req.method == Request::Type::HEAD) {
+    route = &node->routes[methodIndex(Request::Type::GET)];
+  }
+  if (route->empty()) {  // handler for any method
+    route = &node->routes[methodIndex(Request::Type::ILLEGAL)];
+  }
+  if (route->empty()) {
+    req.pathParams.clear();
+    match = Match::MethodNotAllowed;
+    return nullptr;
+  }
+  match = Match::Found;
+  return route;
+}
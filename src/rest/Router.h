@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ROUTER_H
+#define ROUTER_H 1
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Request.h"
+#include "Responder.h"
+#include "Response.h"
+
+namespace asiodemo { namespace rest {
+
+class WorkerPool;
+
+/// either a synchronous handler returning the response, an asynchronous
+/// one answering through the Responder or a streaming one consuming the
+/// body as it arrives
+struct Route {
+  typedef std::function<std::unique_ptr<Response>(Request const&)> HandleFunc;
+  typedef std::function<void(Request const&, Responder)> AsyncHandleFunc;
+  typedef std::function<std::unique_ptr<BodyConsumer>(Request const&,
+                                                      BodyControl)>
+      StreamHandleFunc;
+
+  HandleFunc handler;
+  AsyncHandleFunc asyncHandler;
+  /// receives the body incrementally, see BodyConsumer
+  StreamHandleFunc streamHandler;
+  /// run the handler on this pool instead of the io thread
+  WorkerPool* executor = nullptr;
+
+  bool empty() const { return !handler && !asyncHandler && !streamHandler; }
+};
+
+/// Compressed radix tree over path segments. Chains of static segments
+/// are merged into one node (`/api/v1` is a single edge), every node has
+/// a table of routes per method. Supported patterns:
+///   /users/:id     `:name` captures exactly one segment
+///   /static/*path  `*name` captures the remaining path, must be last
+/// Static segments take precedence over parameters, parameters over
+/// catch-all routes. A trailing slash is ignored.
+class Router {
+ public:
+  enum class Match { Found, NotFound, MethodNotAllowed };
+
+  Router();
+  ~Router();
+
+  /// register a route, Request::Type::ILLEGAL matches any method.
+  /// Throws std::invalid_argument on conflicting patterns
+  void add(Request::Type method, std::string_view path, Route route);
+
+  /// find the route for req.method and req.path, captured parameters are
+  /// stored in req.pathParams. Does not allocate.
+  Route const* find(Request& req, Match& match) const;
+
+ private:
+  struct Node;
+
+  static void insert(Node* node, std::vector<std::string_view> const& segs,
+                     size_t pos, Request::Type method, Route&& route);
+  static Node const* lookup(Node const* node, std::string_view rest,
+                            PathParams& params);
+
+ private:
+  std::unique_ptr<Node> _root;
+};
+
+}}  // namespace asiodemo::rest
+
+#endif
@@ -1,53 +1,426 @@
 
 #include "Server.h"
+#include "Connection.h"
+#include "HandlerMemory.h"
+#include "Logger.h"
+#include "StaticFiles.h"
 
 using namespace asiodemo;
 using namespace asiodemo::rest;
 
+#include <cassert>
+#include <cerrno>
 #include <chrono>
-#include <iostream>
+#include <csignal>
+#include <cstring>
+#include <future>
+#include <limits>
 #include <thread>
 
+#include <asio/signal_set.hpp>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+Server::Server(ServerOptions options)
+    : _options(std::move(options)),
+      _nextIoContext(0),
+      _draining(false),
+      _upgradePid(-1) {
+  if (_options.workerThreads > 0) {
+    _workerPool = std::make_unique<WorkerPool>(_options.workerThreads,
+                                               _options.maxQueuedWork);
+  }
+}
+
+Server::~Server() {
+  if (_workerPool) {
+    _workerPool->stop();
+  }
+  // pending handshakes own sockets of the io contexts
+  _handshakeContexts.clear();
+  for (auto& ctx : _ioContexts) {
+    ctx->stop();
+  }
+  _acceptors.clear();
+  _ioContexts.clear();
+}
+
 void Server::addHandler(std::string path, HandleFunc func) {
-  _handlers.emplace(path, func);
+  addHandler(Request::Type::ILLEGAL, std::move(path), std::move(func));
+}
+
+void Server::addHandler(Request::Type method, std::string path,
+                        HandleFunc func) {
+  Route route;
+  route.handler = std::move(func);
+  _router.add(method, path, std::move(route));
+}
+
+void Server::addHandler(Request::Type method, std::string path,
+                        HandleFunc func, WorkerPool& executor) {
+  Route route;
+  route.handler = std::move(func);
+  route.executor = &executor;
+  _router.add(method, path, std::move(route));
+}
+
+void Server::addStreamingHandler(Request::Type method, std::string path,
+                                 StreamHandleFunc func) {
+  Route route;
+  route.streamHandler = std::move(func);
+  _router.add(method, path, std::move(route));
+}
+
+void Server::addStaticFiles(std::string prefix, std::string directory) {
+  auto files = std::make_shared<StaticFiles>(std::move(directory));
+  addHandler(Request::Type::GET, prefix + "/*path",
+             [files](Request const& req) {
+               bool found;
+               return files->serve(req, req.pathParams.get("path", found));
+             });
+}
+
+void Server::addAsyncHandler(Request::Type method, std::string path,
+                             AsyncHandleFunc func, WorkerPool* executor) {
+  Route route;
+  route.asyncHandler = std::move(func);
+  route.executor = executor;
+  _router.add(method, path, std::move(route));
 }
 
 void Server::listenAndServe() {
-  _ioContext = std::make_shared<asio::io_context>(1);
-  auto guard = asio::make_work_guard(*_ioContext);
-  asio::io_context* ctx = _ioContext.get();
+  _inheritedListeners = SocketHandoff::inherited();
+  bool const upgraded = !_inheritedListeners.empty();
+
+  unsigned n = std::max(1u, _options.ioThreads);
+  for (unsigned i = 0; i < n; ++i) {
+    _ioContexts.emplace_back(std::make_unique<IoContext>(i));
+  }
+  for (auto& ctx : _ioContexts) {
+    ctx->start(_options.pinThreads);
+  }
+  for (unsigned i = 0; i < _options.handshakeThreads; ++i) {
+    // numbered after the io threads, they are pinned to other cpus
+    _handshakeContexts.emplace_back(std::make_unique<IoContext>(n + i));
+    _handshakeContexts.back()->start(_options.pinThreads);
+  }
 
-  std::thread t([ctx]() { ctx->run(); });
+  int const http = _options.httpPort;
+  int const https = _options.httpsPort;
+  if (_options.reusePort) {
+    // one sharded acceptor per port on every io context
+    for (int i = 0; i < static_cast<int>(n); ++i) {
+      IoContext& ctx = *_ioContexts[i];
+      _acceptors.emplace_back(
+          std::make_unique<AcceptorTcp<SocketType::Tcp>>(ctx, *this, http, i));
+      _acceptors.emplace_back(std::make_unique<AcceptorTcp<SocketType::Ssl>>(
+          ctx, *this, https, i));
+    }
+    // a predecessor with more io threads passed more shards, closing
+    // them would reset the connections queued on them
+    for (int i = n; _inheritedListeners.contains(
+                        AcceptorTcp<SocketType::Tcp>::listenName(http, i));
+         ++i) {
+      _acceptors.emplace_back(std::make_unique<AcceptorTcp<SocketType::Tcp>>(
+          *_ioContexts[i % n], *this, http, i));
+    }
+    for (int i = n; _inheritedListeners.contains(
+                        AcceptorTcp<SocketType::Ssl>::listenName(https, i));
+         ++i) {
+      _acceptors.emplace_back(std::make_unique<AcceptorTcp<SocketType::Ssl>>(
+          *_ioContexts[i % n], *this, https, i));
+    }
+  } else {
+    // acceptors only hand out sockets, connections are spread over all
+    // contexts
+    IoContext& acceptCtx = *_ioContexts[0];
+    _acceptors.emplace_back(
+        std::make_unique<AcceptorTcp<SocketType::Tcp>>(acceptCtx, *this, http));
+    _acceptors.emplace_back(std::make_unique<AcceptorTcp<SocketType::Ssl>>(
+        acceptCtx, *this, https));
+  }
+  if (!_options.unixSocketPath.empty()) {
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+    // there is no kernel balancing for unix sockets, one acceptor spreads
+    // the connections over all contexts
+    _acceptors.emplace_back(std::make_unique<AcceptorUnix>(
+        *_ioContexts[0], *this, _options.unixSocketPath));
+#else
+    LOG_WARN("unix domain sockets are not supported on this platform");
+#endif
+  }
+  // the signals are delivered to this thread, which is idle otherwise
+  asio::io_context signalContext(1);
+  asio::signal_set signals(signalContext, SIGINT, SIGTERM);
+#ifndef _WIN32
+  signals.add(SIGUSR2);
+#endif
+  waitForSignal(signals);
 
-  auto acceptorTcp =
-      std::make_unique<AcceptorTcp<SocketType::Tcp>>(*_ioContext, *this, 80);
-  acceptorTcp->open();
+  for (auto& acceptor : _acceptors) {
+    acceptor->open();
+  }
+  _inheritedListeners.closeUnused();
+#ifndef _WIN32
+  if (upgraded) {
+    // accepting already, the previous process can drain
+    LOG_INFO("took over the listening sockets of process ", ::getppid());
+    ::kill(::getppid(), SIGTERM);
+  }
+#endif
 
-  auto acceptorTLS =
-      std::make_unique<AcceptorTcp<SocketType::Ssl>>(*_ioContext, *this, 443);
-  acceptorTLS->open();
+  signalContext.run();
+  drain();
 
-  // TODO use a signal handler
-  std::this_thread::sleep_for(std::chrono::seconds(120));
+  // offloaded handlers post their responses to the io contexts
+  if (_workerPool) {
+    _workerPool->stop();
+  }
+  for (auto& ctx : _handshakeContexts) {
+    ctx->stop();
+  }
+  for (auto& ctx : _ioContexts) {
+    ctx->stop();
+  }
+  for (auto& acceptor : _acceptors) {
+    Acceptor::Stats const& stats = acceptor->stats();
+    uint64_t handshakes = stats.handshakes.load();
+    if (handshakes > 0) {
+      LOG_INFO("TLS handshake latency: ", handshakes, " handshakes, avg ",
+               stats.handshakeMicros.load() / handshakes, "us, max ",
+               stats.maxHandshakeMicros.load(), "us, max queued ",
+               stats.maxHandshakesQueued.load());
+      LOG_INFO("kTLS enabled for ", stats.kernelTls.load(), " of ",
+               handshakes, " TLS connections");
+    }
+  }
+  _acceptors.clear();
+  _handshakeContexts.clear();
 
-  guard.reset();  // allow run() to exit
-  t.join();
-  _ioContext->stop();
+  LOG_INFO("handler operations allocated on the heap: ",
+           HandlerMemory::heapAllocations());
+  if (_tlsSessions) {
+    TlsSessionCache::Stats const& stats = _tlsSessions->stats();
+    LOG_INFO("TLS handshakes: ", stats.fullHandshakes.load(), " full, ",
+             stats.resumedHandshakes.load(), " resumed (hit rate ",
+             _tlsSessions->hitRate(), "), session cache hits ",
+             stats.cacheHits.load(), ", misses ", stats.cacheMisses.load(),
+             ", rejected tickets ", stats.ticketsRejected.load(),
+             ", ticket keys ", stats.keyRotations.load());
+  }
 }
 
-std::unique_ptr<Response> Server::execute(Request const& req) {
-  auto const& it = _handlers.find(req.path);
-  if (it != _handlers.end()) {
-    return it->second(req);
+void Server::waitForSignal(asio::signal_set& signals) {
+  signals.async_wait([this, &signals](asio::error_code const& ec, int signal) {
+    if (ec) {
+      return;
+    }
+#ifndef _WIN32
+    if (signal == SIGUSR2) {
+      upgrade();
+      waitForSignal(signals);
+      return;
+    }
+#endif
+    LOG_INFO("received signal ", signal, ", shutting down");
+  });
+}
+
+void Server::upgrade() {
+#ifndef _WIN32
+  if (_options.upgradeCommand.empty()) {
+    LOG_WARN("no upgrade command configured, ignoring SIGUSR2");
+    return;
+  }
+  if (_upgradePid > 0 && ::waitpid(_upgradePid, nullptr, WNOHANG) == 0) {
+    LOG_WARN("process ", _upgradePid, " is already replacing this one");
+    return;
+  }
+  SocketHandoff::Listeners listeners;
+  for (auto& acceptor : _acceptors) {
+    listeners.emplace_back(acceptor->listenName(), acceptor->nativeHandle());
+  }
+  _upgradePid = SocketHandoff::spawn(_options.upgradeCommand, listeners);
+  if (_upgradePid < 0) {
+    LOG_ERROR("unable to start the new process: ", std::strerror(errno));
+  } else {
+    LOG_INFO("started process ", _upgradePid, " to replace this one");
+  }
+#endif
+}
+
+void Server::drain() {
+  _draining.store(true, std::memory_order_relaxed);
+
+#ifndef _WIN32
+  // the new process of an upgrade keeps using the listening sockets
+  bool handedOver =
+      _upgradePid > 0 && ::waitpid(_upgradePid, nullptr, WNOHANG) == 0;
+#else
+  bool handedOver = false;
+#endif
+
+  // acceptors are only used by the thread of their context
+  std::vector<std::future<void>> closed;
+  for (auto& acceptor : _acceptors) {
+    auto done = std::make_shared<std::promise<void>>();
+    closed.push_back(done->get_future());
+    asio::post(acceptor->context().io_context,
+               [acceptor = acceptor.get(), handedOver, done]() {
+                 if (handedOver) {
+                   acceptor->handOver();
+                 }
+                 acceptor->close();
+                 done->set_value();
+               });
+  }
+  for (auto& f : closed) {
+    f.wait();
+  }
+
+  // connections started from now on see draining()
+  for (auto& ctx : _ioContexts) {
+    asio::post(ctx->io_context, [ctx = ctx.get()]() {
+      ctx->drainConnections();
+    });
+  }
+
+  auto pending = [this]() {
+    unsigned n = 0;
+    for (auto& ctx : _ioContexts) {
+      n += ctx->connections();
+    }
+    for (auto& ctx : _handshakeContexts) {
+      n += ctx->clients();  // pending handshakes
+    }
+    return n;
+  };
+  auto deadline = std::chrono::steady_clock::now() + _options.drainTimeout;
+  unsigned n = pending();
+  while (n > 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    n = pending();
+  }
+  if (n > 0) {
+    LOG_WARN("closing ", n, " connections which did not finish within ",
+             _options.drainTimeout.count(), "s");
+  } else {
+    LOG_INFO("all connections finished");
+  }
+}
+
+IoContext* Server::selectHandshakeContext() {
+  IoContext* best = nullptr;
+  for (auto& ctx : _handshakeContexts) {
+    if (best == nullptr || ctx->clients() < best->clients()) {
+      best = ctx.get();
+    }
+  }
+  return best;
+}
+
+IoContext& Server::selectIoContext() {
+  assert(!_ioContexts.empty());
+  if (_options.selection == IoContextSelection::RoundRobin) {
+    unsigned i = _nextIoContext.fetch_add(1, std::memory_order_relaxed);
+    return *_ioContexts[i % _ioContexts.size()];
+  }
+
+  // least loaded: the context with the fewest clients
+  size_t best = 0;
+  unsigned min = std::numeric_limits<unsigned>::max();
+  for (size_t i = 0; i < _ioContexts.size(); ++i) {
+    unsigned clients = _ioContexts[i]->clients();
+    if (clients < min) {
+      min = clients;
+      best = i;
+      if (clients == 0) {
+        break;
+      }
+    }
+  }
+  return *_ioContexts[best];
+}
+
+std::unique_ptr<Response> Server::execute(Request& req, AbstrConn& conn) {
+  Router::Match match;
+  Route const* route = _router.find(req, match);
+  if (route != nullptr) {
+    if (route->streamHandler) {  // a request without a body
+      auto consumer =
+          route->streamHandler(req, BodyControl(conn.shared_from_this()));
+      if (consumer) {
+        consumer->onComplete(Responder(conn.shared_from_this()));
+        return nullptr;
+      }
+      auto res = std::make_unique<Response>();
+      res->status_code = ResponseCode::SERVER_ERROR;
+      return res;
+    }
+    if (route->executor == nullptr) {
+      if (route->handler) {
+        return route->handler(req);
+      }
+      route->asyncHandler(req, Responder(conn.shared_from_this()));
+      return nullptr;
+    }
+
+    if (!route->executor->tryAcquire()) {
+      auto res = std::make_unique<Response>();
+      res->status_code = ResponseCode::SERVICE_UNAVAILABLE;
+      return res;
+    }
+    // the connection does not touch the request until it is answered
+    route->executor->post([route, &req,
+                           responder = Responder(conn.shared_from_this())]()
+                              mutable {
+      if (route->handler) {
+        responder.send(route->handler(req));
+      } else {
+        route->asyncHandler(req, std::move(responder));
+      }
+    });
+    return nullptr;
   }
 
   auto res = std::make_unique<Response>();
-  res->status_code = ResponseCode::NOT_FOUND;
   res->body = std::make_unique<std::string>();
-  res->body->append("Could not find the handler");
+  if (match == Router::Match::MethodNotAllowed) {
+    res->status_code = ResponseCode::METHOD_NOT_ALLOWED;
+    res->body->append("Method not allowed for this path");
+  } else {
+    res->status_code = ResponseCode::NOT_FOUND;
+    res->body->append("Could not find the handler");
+  }
   return res;
 }
 
+std::unique_ptr<BodyConsumer> Server::openBodyStream(Request& req,
+                                                     AbstrConn& conn,
+                                                     bool& accepted) {
+  Router::Match match;
+  Route const* route = _router.find(req, match);
+  accepted = true;
+  if (route == nullptr || !route->streamHandler) {
+    return nullptr;
+  }
+  auto consumer =
+      route->streamHandler(req, BodyControl(conn.shared_from_this()));
+  accepted = consumer != nullptr;
+  return consumer;
+}
+
+void Server::completeBodyStream(Request& req, AbstrConn& conn,
+                                std::unique_ptr<BodyConsumer> consumer) {
+  // the path parameters may point to where the receive buffer was
+  Router::Match match;
+  _router.find(req, match);
+  consumer->onComplete(Responder(conn.shared_from_this()));
+}
+
 asio::ssl::context& Server::sslContext() {
   std::lock_guard<std::mutex> guard(_sslContextMutex);
   if (!_sslContext) {
@@ -63,16 +436,27 @@ asio::ssl::context& Server::sslContext() {
     asio::error_code ec;
     _sslContext->use_certificate_chain_file(keyfile, ec);
     if (ec) {
-      std::cout << "cannot read certificate from '" << keyfile << "': " << ec;
+      LOG_ERROR("cannot read certificate from '", keyfile, "': ", ec.message());
+      log::Logger::flush();
       exit(1);
     }
 
     _sslContext->use_private_key_file(keyfile,
                                       asio::ssl::context::file_format::pem, ec);
     if (ec) {
-      std::cout << "cannot read key from '" << keyfile << "': " << ec;
+      LOG_ERROR("cannot read key from '", keyfile, "': ", ec.message());
+      log::Logger::flush();
       exit(1);
     }
+
+    _tlsSessions = std::make_unique<TlsSessionCache>(
+        _options.tlsSessionCacheSize, _options.tlsTicketKeyRotation);
+    _tlsSessions->attach(_sslContext->native_handle());
+    if (_options.kernelTls) {
+      // OpenSSL must not write records once the kernel encrypts them
+      SSL_CTX_set_options(_sslContext->native_handle(),
+                          SSL_OP_NO_RENEGOTIATION);
+    }
   }
   return *_sslContext;
 }
@@ -7,41 +7,189 @@
 #ifndef SERVER_H
 #define SERVER_H 1
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "Acceptor.h"
+#include "IoContext.h"
 #include "Request.h"
 #include "Response.h"
+#include "Router.h"
+#include "SocketHandoff.h"
+#include "TlsSessionCache.h"
+#include "WorkerPool.h"
 
 namespace asiodemo { namespace rest {
 
+/// strategy used to bind a new connection to an io context
+enum class IoContextSelection { RoundRobin = 1, LeastLoaded = 2 };
+
+struct ServerOptions {
+  /// number of io threads, each one runs its own io_context
+  unsigned ioThreads = std::max(1u, std::thread::hardware_concurrency());
+  /// pin each io thread to a dedicated cpu
+  bool pinThreads = true;
+  IoContextSelection selection = IoContextSelection::LeastLoaded;
+  /// open one acceptor per io context on the same port (SO_REUSEPORT),
+  /// the kernel balances new connections and they never change threads
+  bool reusePort = false;
+  /// ports of the plain HTTP and the TLS listener
+  int httpPort = 80;
+  int httpsPort = 443;
+  /// also listen on this unix domain socket, empty disables it
+  std::string unixSocketPath;
+  /// TLS sessions cached for resumption by session id, 0 disables it
+  size_t tlsSessionCacheSize = 20480;
+  /// lifetime of a TLS session ticket key (and of the sessions),
+  /// 0 disables session tickets
+  std::chrono::seconds tlsTicketKeyRotation{3600};
+  /// let the kernel encrypt the responses of established TLS connections
+  /// (Linux kTLS, TLS 1.2 with AES-GCM), which also enables sendfile(2).
+  /// Connections which cannot use it stay with OpenSSL
+  bool kernelTls = false;
+  /// length of the kernel accept queue
+  int listenBacklog = asio::socket_base::max_listen_connections;
+  /// accept all pending connections in one wakeup
+  bool batchAccept = true;
+  /// idle connections wait for readability without a receive buffer and
+  /// only borrow one when data arrives (plaintext sockets)
+  bool readinessWait = true;
+  /// try a non-blocking write of the response before falling back to
+  /// async_write (sockets not encrypting with OpenSSL)
+  bool syncWrite = true;
+  /// pipelined requests answered before the responses are flushed with
+  /// one gathered write, bounds the queued responses per connection
+  size_t maxPipelinedRequests = 16;
+  /// on SIGINT or SIGTERM the open connections get this long to finish
+  /// their current requests before the server stops
+  std::chrono::seconds drainTimeout{30};
+  /// command line started on SIGUSR2 to replace this process (binary
+  /// upgrade). The new process inherits the listening sockets, starts
+  /// accepting on them and then lets this one drain with SIGTERM.
+  /// Empty disables it
+  std::vector<std::string> upgradeCommand;
+  /// threads running TLS handshakes, established connections are then
+  /// handed to the io threads. 0 runs handshakes on the io threads
+  unsigned handshakeThreads = 0;
+  /// threads of the default worker pool for offloaded handlers,
+  /// 0 disables it
+  unsigned workerThreads = 0;
+  /// jobs queued or running on the default worker pool, more are
+  /// answered with 503
+  size_t maxQueuedWork = 1024;
+};
+
 class Server {
-  typedef std::function<std::unique_ptr<Response>(Request const&)> HandleFunc;
+  typedef Route::HandleFunc HandleFunc;
+  typedef Route::AsyncHandleFunc AsyncHandleFunc;
+  typedef Route::StreamHandleFunc StreamHandleFunc;
 
  public:
-  Server() {}
-  ~Server() {}
+  explicit Server(ServerOptions options = ServerOptions());
+  ~Server();
 
-  void addHandler(std::string path, HandleFunc);
+  ServerOptions const& options() const { return _options; }
 
+  /// handler for all methods, see Router for the path syntax
+  void addHandler(std::string path, HandleFunc);
+  void addHandler(Request::Type method, std::string path, HandleFunc);
+  /// handler running on a worker pool, e.g. workerPool()
+  void addHandler(Request::Type method, std::string path, HandleFunc,
+                  WorkerPool& executor);
+  /// handler answering through the Responder, runs on the io thread
+  /// unless an executor is given
+  void addAsyncHandler(Request::Type method, std::string path,
+                       AsyncHandleFunc, WorkerPool* executor = nullptr);
+
+  /// handler receiving the request body in chunks, the body is not
+  /// buffered and not limited in size
+  void addStreamingHandler(Request::Type method, std::string path,
+                           StreamHandleFunc);
+
+  /// serve the files below `directory` for GET and HEAD requests to
+  /// `prefix/<path>`, see StaticFiles
+  void addStaticFiles(std::string prefix, std::string directory);
+
+  /// default pool for offloaded handlers, nullptr unless
+  /// options().workerThreads > 0
+  WorkerPool* workerPool() const { return _workerPool.get(); }
+
+  /// serve until SIGINT or SIGTERM, then stop accepting and wait for the
+  /// open connections to finish (see ServerOptions::drainTimeout)
   void listenAndServe();
+  /// the server shuts down, connections close after their current request
+  bool draining() const { return _draining.load(std::memory_order_relaxed); }
 
-  asio::ssl::context& sslContext();
+  /// a listening socket passed on by the process this one replaces (see
+  /// SocketHandoff), -1 if there is none. Used by Acceptor::open()
+  int takeInheritedListener(std::string const& name) {
+    return _inheritedListeners.take(name);
+  }
 
-  std::unique_ptr<Response> execute(Request const&);
+  asio::ssl::context& sslContext();
+  /// session resumption of sslContext(), nullptr before it is created
+  TlsSessionCache* tlsSessions() const { return _tlsSessions.get(); }
+
+  /// route the request and run its handler, fills req.pathParams.
+  /// Returns nullptr if the handler answers later through a Responder,
+  /// the request must stay valid until then
+  std::unique_ptr<Response> execute(Request&, AbstrConn& conn);
+
+  /// consumer for the body of the request if it is routed to a streaming
+  /// handler (called once the header is complete), nullptr otherwise.
+  /// `accepted` is false if the handler refused the request
+  std::unique_ptr<BodyConsumer> openBodyStream(Request&, AbstrConn& conn,
+                                               bool& accepted);
+  /// the body of a streamed request is complete
+  void completeBodyStream(Request&, AbstrConn& conn,
+                          std::unique_ptr<BodyConsumer> consumer);
+
+  /// choose the io context for a new connection
+  IoContext& selectIoContext();
+  /// context to run a TLS handshake on, nullptr to use the connection's
+  IoContext* selectHandshakeContext();
 
  private:
-  std::map<std::string, HandleFunc> _handlers;
+  /// wait for the next signal, returns (stops the signal context) on
+  /// SIGINT or SIGTERM
+  void waitForSignal(asio::signal_set& signals);
+  /// start the process replacing this one with the listening sockets
+  void upgrade();
+  /// close the acceptors and wait for the connections to finish
+  void drain();
+
+  ServerOptions const _options;
+
+  Router _router;
+  std::unique_ptr<WorkerPool> _workerPool;
 
   /// protect ssl context creation
   std::mutex _sslContextMutex;
+  /// must outlive _sslContext
+  std::unique_ptr<TlsSessionCache> _tlsSessions;
   /// global SSL context to use here
   std::unique_ptr<asio::ssl::context> _sslContext;
 
-  /// io contexts
-  std::shared_ptr<asio::io_context> _ioContext;
+  /// io contexts, each one is run by a single thread
+  std::vector<std::unique_ptr<IoContext>> _ioContexts;
+  /// contexts running TLS handshakes only, the count of their clients is
+  /// the number of pending handshakes
+  std::vector<std::unique_ptr<IoContext>> _handshakeContexts;
+  /// next io context for round robin selection
+  std::atomic<unsigned> _nextIoContext;
+
+  std::vector<std::unique_ptr<Acceptor>> _acceptors;
+  std::atomic<bool> _draining;
+
+  /// listening sockets of the previous process, taken by the acceptors
+  SocketHandoff _inheritedListeners;
+  /// process started by upgrade(), -1 if none
+  int _upgradePid;
 };
 
 }}  // namespace asiodemo::rest
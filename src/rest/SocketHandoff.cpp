@@ -0,0 +1,154 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "SocketHandoff.h"
+#include "Logger.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/close_range.h>
+#endif
+
+extern char** environ;
+#endif
+
+using namespace asiodemo::rest;
+
+SocketHandoff SocketHandoff::inherited() {
+  SocketHandoff result;
+  char const* value = std::getenv(EnvVar);
+  if (value == nullptr) {
+    return result;
+  }
+  std::string_view list(value);
+  while (!list.empty()) {
+    size_t pos = list.find(';');
+    std::string_view item = list.substr(0, pos);
+    size_t eq = item.rfind('=');
+    int fd = -1;
+    if (eq != std::string_view::npos) {
+      std::from_chars(item.data() + eq + 1, item.data() + item.size(), fd);
+    }
+    if (fd >= 0) {
+      result._listeners.emplace_back(std::string(item.substr(0, eq)), fd);
+    } else {
+      LOG_WARN("ignoring malformed entry of ", EnvVar, ": '", std::string(item),
+               "'");
+    }
+    if (pos == std::string_view::npos) {
+      break;
+    }
+    list.remove_prefix(pos + 1);
+  }
+#ifndef _WIN32
+  // not passed on to processes started by this one
+  ::unsetenv(EnvVar);
+#endif
+  return result;
+}
+
+bool SocketHandoff::contains(std::string const& name) const {
+  for (auto const& it : _listeners) {
+    if (it.first == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int SocketHandoff::take(std::string const& name) {
+  for (auto it = _listeners.begin(); it != _listeners.end(); ++it) {
+    if (it->first == name) {
+      int fd = it->second;
+      _listeners.erase(it);
+      return fd;
+    }
+  }
+  return -1;
+}
+
+void SocketHandoff::closeUnused() {
+  for (auto const& it : _listeners) {
+    LOG_INFO("closing inherited socket '", it.first, "', it is not used");
+#ifndef _WIN32
+    ::close(it.second);
+#endif
+  }
+  _listeners.clear();
+}
+
+int SocketHandoff::spawn(std::vector<std::string> const& command,
+                         Listeners const& listeners) {
+#ifdef _WIN32
+  return -1;
+#else
+  if (command.empty()) {
+    return -1;
+  }
+  // everything is prepared before fork(), the child of a multi-threaded
+  // process may only make async-signal-safe calls
+  std::string value;
+  for (auto const& it : listeners) {
+    if (!value.empty()) {
+      value.push_back(';');
+    }
+    value.append(it.first).append("=").append(std::to_string(it.second));
+  }
+  std::string const prefix = std::string(EnvVar) + "=";
+  std::vector<std::string> env;
+  for (char** e = environ; *e != nullptr; ++e) {
+    if (std::strncmp(*e, prefix.data(), prefix.size()) != 0) {
+      env.emplace_back(*e);
+    }
+  }
+  env.push_back(prefix + value);
+
+  std::vector<char*> argv;
+  for (auto const& arg : command) {
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  std::vector<char*> envp;
+  for (auto const& var : env) {
+    envp.push_back(const_cast<char*>(var.c_str()));
+  }
+  envp.push_back(nullptr);
+
+  struct rlimit limit;
+  int maxFd = ::getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+                      limit.rlim_cur != RLIM_INFINITY
+                  ? static_cast<int>(limit.rlim_cur)
+                  : 65536;
+
+  pid_t pid = ::fork();
+  if (pid != 0) {
+    return pid;  // -1 on failure
+  }
+
+  // only the listening sockets survive the exec, not the connections
+  // or the descriptors of the event loop
+  bool marked = false;
+#if defined(SYS_close_range) && defined(CLOSE_RANGE_CLOEXEC)
+  marked = ::syscall(SYS_close_range, 3U, ~0U, CLOSE_RANGE_CLOEXEC) == 0;
+#endif
+  for (int fd = 3; !marked && fd < maxFd; ++fd) {
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+  for (auto const& it : listeners) {
+    ::fcntl(it.second, F_SETFD, 0);
+  }
+  environ = envp.data();  // execvp() searches PATH with this environment
+  ::execvp(argv[0], argv.data());
+  ::_exit(127);
+#endif
+}
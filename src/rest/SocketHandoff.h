@@ -0,0 +1,48 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SOCKET_HANDOFF_H
+#define SOCKET_HANDOFF_H 1
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace asiodemo { namespace rest {
+
+/// Listening sockets passed from a running server to the process
+/// replacing it (binary upgrade without downtime). The descriptors are
+/// inherited through exec, the environment variable ASIODEMO_LISTEN_FDS
+/// names them, e.g. "tcp:80=3;tcp:443=4;unix:/tmp/asiodemo.sock=5".
+class SocketHandoff {
+ public:
+  static constexpr char const* EnvVar = "ASIODEMO_LISTEN_FDS";
+
+  /// listening socket name (see Acceptor::listenName()) and descriptor
+  typedef std::vector<std::pair<std::string, int>> Listeners;
+
+  /// the sockets listed in the environment, the variable is removed
+  static SocketHandoff inherited();
+
+  /// start `command` with `listeners`, returns the pid of the new
+  /// process or -1
+  static int spawn(std::vector<std::string> const& command,
+                   Listeners const& listeners);
+
+  bool empty() const { return _listeners.empty(); }
+  /// whether a socket named `name` was inherited and not taken yet
+  bool contains(std::string const& name) const;
+
+  /// take an inherited socket named `name`, -1 if there is none
+  int take(std::string const& name);
+  /// close the sockets no acceptor took
+  void closeUnused();
+
+ private:
+  Listeners _listeners;
+};
+
+}}  // namespace asiodemo::rest
+
+#endif
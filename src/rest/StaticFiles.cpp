@@ -0,0 +1,316 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "StaticFiles.h"
+#include "Logger.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace asiodemo;
+using namespace asiodemo::rest;
+
+namespace {
+
+enum class RangeResult { Ignore, Satisfiable, Unsatisfiable };
+
+int64_t steadySeconds() {
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string makeETag(struct stat const& st) {
+  int64_t mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                  st.st_mtim.tv_nsec;
+  char buf[64];
+  int n = std::snprintf(buf, sizeof(buf), "\"%llx-%llx-%llx\"",
+                        static_cast<unsigned long long>(st.st_ino),
+                        static_cast<unsigned long long>(st.st_size),
+                        static_cast<unsigned long long>(mtime));
+  return std::string(buf, n);
+}
+
+/// no ".." segments, nothing outside the root is reachable
+bool isSafePath(std::string_view path) {
+  if (path.find('\0') != std::string_view::npos) {
+    return false;
+  }
+  while (!path.empty()) {
+    size_t pos = path.find('/');
+    if (path.substr(0, pos) == "..") {
+      return false;
+    }
+    if (pos == std::string_view::npos) {
+      break;
+    }
+    path.remove_prefix(pos + 1);
+  }
+  return true;
+}
+
+std::string_view contentType(std::string_view path) {
+  static constexpr std::pair<std::string_view, std::string_view> types[] = {
+      {".html", "text/html; charset=utf-8"},
+      {".htm", "text/html; charset=utf-8"},
+      {".css", "text/css; charset=utf-8"},
+      {".js", "application/javascript; charset=utf-8"},
+      {".json", "application/json; charset=utf-8"},
+      {".txt", "text/plain; charset=utf-8"},
+      {".svg", "image/svg+xml"},
+      {".png", "image/png"},
+      {".jpg", "image/jpeg"},
+      {".jpeg", "image/jpeg"},
+      {".gif", "image/gif"},
+      {".ico", "image/x-icon"},
+      {".woff2", "font/woff2"},
+      {".pdf", "application/pdf"},
+      {".wasm", "application/wasm"}};
+  size_t dot = path.rfind('.');
+  if (dot != std::string_view::npos && path.find('/', dot) == path.npos) {
+    std::string_view ext = path.substr(dot);
+    for (auto const& it : types) {
+      if (headers::equalsIgnoreCase(it.first, ext)) {
+        return it.second;
+      }
+    }
+  }
+  return "application/octet-stream";
+}
+
+/// If-None-Match: "*" or a list of (weak) entity tags
+bool matchesETag(std::string_view list, std::string_view etag) {
+  while (!list.empty()) {
+    size_t pos = list.find(',');
+    std::string_view tag = utils::trim(list.substr(0, pos));
+    if (tag == "*") {
+      return true;
+    }
+    if (tag.substr(0, 2) == "W/") {  // weak comparison
+      tag.remove_prefix(2);
+    }
+    if (tag == etag) {
+      return true;
+    }
+    if (pos == std::string_view::npos) {
+      break;
+    }
+    list.remove_prefix(pos + 1);
+  }
+  return false;
+}
+
+bool parseUInt(std::string_view s, uint64_t& value) {
+  auto res = std::from_chars(s.data(), s.data() + s.size(), value);
+  return !s.empty() && res.ec == std::errc() && res.ptr == s.data() + s.size();
+}
+
+/// single "bytes=first-last", "bytes=first-" or "bytes=-suffix" range,
+/// multiple ranges are answered with the complete file
+RangeResult parseRange(std::string_view range, uint64_t size,
+                       uint64_t& offset, uint64_t& length) {
+  range = utils::trim(range);
+  if (range.substr(0, 6) != "bytes=" ||
+      range.find(',') != std::string_view::npos) {
+    return RangeResult::Ignore;
+  }
+  range.remove_prefix(6);
+  size_t dash = range.find('-');
+  if (dash == std::string_view::npos) {
+    return RangeResult::Ignore;
+  }
+  std::string_view first = utils::trim(range.substr(0, dash));
+  std::string_view last = utils::trim(range.substr(dash + 1));
+
+  uint64_t a, b;
+  if (first.empty()) {  // the last b bytes
+    if (!parseUInt(last, b)) {
+      return RangeResult::Ignore;
+    }
+    if (b == 0 || size == 0) {
+      return RangeResult::Unsatisfiable;
+    }
+    length = std::min(b, size);
+    offset = size - length;
+    return RangeResult::Satisfiable;
+  }
+
+  if (!parseUInt(first, a)) {
+    return RangeResult::Ignore;
+  }
+  b = size == 0 ? 0 : size - 1;
+  if (!last.empty()) {
+    if (!parseUInt(last, b) || b < a) {
+      return RangeResult::Ignore;
+    }
+    b = std::min(b, size - 1);
+  }
+  if (a >= size) {
+    return RangeResult::Unsatisfiable;
+  }
+  offset = a;
+  length = b - a + 1;
+  return RangeResult::Satisfiable;
+}
+
+}  // namespace
+
+StaticFile::~StaticFile() { ::close(fd); }
+
+bool FileProducer::produce(std::string& out) {
+  size_t n = static_cast<size_t>(std::min<uint64_t>(_remaining, PieceSize));
+  size_t pos = out.size();
+  out.resize(pos + n);
+  while (n > 0) {
+    ssize_t nread = ::pread(_file->fd, &out[pos], n, _offset);
+    if (nread < 0 && errno == EINTR) {
+      continue;
+    }
+    if (nread <= 0) {  // the file was truncated
+      LOG_WARN("unable to read static file: ", nread < 0 ? errno : 0);
+      out.resize(pos);
+      _remaining = 0;
+      return false;
+    }
+    pos += nread;
+    n -= nread;
+    _offset += nread;
+    _remaining -= nread;
+  }
+  return _remaining > 0;
+}
+
+StaticFiles::StaticFiles(std::string root, size_t maxOpenFiles)
+    : _root(std::move(root)),
+      _maxOpenFiles(std::max<size_t>(1, maxOpenFiles)) {}
+
+StaticFiles::~StaticFiles() {}
+
+std::shared_ptr<StaticFile const> StaticFiles::open(std::string_view path) {
+  std::string key(path);
+  int64_t now = steadySeconds();
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    auto it = _files.find(key);
+    if (it != _files.end() && now - it->second.checked < 1) {
+      return it->second.file;
+    }
+    auto missing = _missing.find(key);
+    if (missing != _missing.end() && now - missing->second < 1) {
+      return nullptr;
+    }
+  }
+
+  // the file system is only asked without holding the lock
+  std::string full = _root + "/" + key;
+  struct stat st;
+  if (::stat(full.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _files.erase(key);
+    rememberMissing(std::move(key), now);
+    return nullptr;
+  }
+  std::string etag = makeETag(st);
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    auto it = _files.find(key);
+    if (it != _files.end() && it->second.file->etag == etag) {
+      it->second.checked = now;
+      return it->second.file;
+    }
+  }
+
+  int fd = ::open(full.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    rememberMissing(std::move(key), now);
+    return nullptr;
+  }
+  // the file may have been replaced after stat(2)
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    ::close(fd);
+    return nullptr;
+  }
+  auto file = std::make_shared<StaticFile const>(
+      fd, static_cast<uint64_t>(st.st_size), makeETag(st));
+
+  std::lock_guard<std::mutex> guard(_mutex);
+  auto it = _files.find(key);
+  if (it == _files.end() && _files.size() >= _maxOpenFiles) {
+    // responses still sending the evicted file keep it open
+    _files.erase(_files.begin());
+  }
+  _missing.erase(key);
+  _files[std::move(key)] = Entry{file, now};
+  return file;
+}
+
+void StaticFiles::rememberMissing(std::string key, int64_t now) {
+  if (_missing.size() >= _maxOpenFiles) {
+    _missing.clear();  // requests for random paths must not grow it
+  }
+  _missing[std::move(key)] = now;
+}
+
+std::unique_ptr<Response> StaticFiles::serve(Request const& req,
+                                             std::string_view path) {
+  auto res = std::make_unique<Response>();
+  std::shared_ptr<StaticFile const> file =
+      isSafePath(path) ? open(path) : nullptr;
+  if (!file) {
+    res->status_code = ResponseCode::NOT_FOUND;
+    return res;
+  }
+  res->headers.add("ETag", file->etag);
+  res->headers.add("accept-ranges", "bytes");
+  res->headers.add("content-type", std::string(contentType(path)));
+
+  bool found;
+  std::string_view ifNoneMatch = req.header("if-none-match", found);
+  if (found && matchesETag(ifNoneMatch, file->etag)) {
+    // carries the length of the file, the body is never sent
+    res->status_code = ResponseCode::NOT_MODIFIED;
+    res->file = std::move(file);
+    res->fileLength = res->file->size;
+    return res;
+  }
+
+  uint64_t offset = 0;
+  uint64_t length = file->size;
+  res->status_code = ResponseCode::OK;
+  std::string_view range = req.header("range", found);
+  if (found) {
+    // a Last-Modified date is never sent, so it never matches If-Range
+    std::string_view ifRange = req.header("if-range", found);
+    RangeResult result =
+        (!found || utils::trim(ifRange) == file->etag)
+            ? parseRange(range, file->size, offset, length)
+            : RangeResult::Ignore;
+    if (result == RangeResult::Unsatisfiable) {
+      res->status_code = ResponseCode::REQUESTED_RANGE_NOT_SATISFIABLE;
+      res->headers.add("content-range",
+                       "bytes */" + std::to_string(file->size));
+      return res;
+    }
+    if (result == RangeResult::Satisfiable) {
+      res->status_code = ResponseCode::PARTIAL_CONTENT;
+      res->headers.add("content-range",
+                       "bytes " + std::to_string(offset) + "-" +
+                           std::to_string(offset + length - 1) + "/" +
+                           std::to_string(file->size));
+    }
+  }
+  res->file = std::move(file);
+  res->fileOffset = offset;
+  res->fileLength = length;
+  return res;
+}
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STATIC_FILES_H
+#define STATIC_FILES_H 1
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "Request.h"
+#include "Response.h"
+
+namespace asiodemo { namespace rest {
+
+/// an open regular file, shared by the cache and all responses sending it.
+/// The descriptor is closed with the last reference
+struct StaticFile {
+  StaticFile(int fd, uint64_t size, std::string etag)
+      : fd(fd), size(size), etag(std::move(etag)) {}
+  ~StaticFile();
+  StaticFile(StaticFile const&) = delete;
+  StaticFile& operator=(StaticFile const&) = delete;
+
+  int const fd;
+  uint64_t const size;
+  /// quoted strong validator derived from inode, size and mtime
+  std::string const etag;
+};
+
+/// reads a range of a file with pread(2), used for sockets which
+/// cannot sendfile(2) (TLS)
+class FileProducer : public BodyProducer {
+ public:
+  static constexpr size_t PieceSize = 64 * 1024;
+
+  FileProducer(std::shared_ptr<StaticFile const> file, uint64_t offset,
+               uint64_t length)
+      : _file(std::move(file)), _offset(offset), _remaining(length) {}
+
+  bool produce(std::string& out) override;
+
+ private:
+  std::shared_ptr<StaticFile const> _file;
+  uint64_t _offset;
+  uint64_t _remaining;
+};
+
+/// Serves the regular files below a directory. Open descriptors, sizes
+/// and ETags are cached, an entry is checked against the file system at
+/// most once per second. Paths that are not found are remembered for a
+/// second as well, repeated 404s do not stat(2) on the io thread.
+/// Supports If-None-Match and single byte ranges (Range, If-Range).
+/// Paths containing ".." segments are rejected.
+class StaticFiles {
+ public:
+  explicit StaticFiles(std::string root, size_t maxOpenFiles = 1024);
+  ~StaticFiles();
+
+  /// answer a GET or HEAD request for `path` relative to the root
+  std::unique_ptr<Response> serve(Request const& req, std::string_view path);
+
+  /// the cached file for `path`, nullptr if it is not a readable
+  /// regular file
+  std::shared_ptr<StaticFile const> open(std::string_view path);
+
+ private:
+  struct Entry {
+    std::shared_ptr<StaticFile const> file;
+    /// steady clock seconds of the last stat(2)
+    int64_t checked;
+  };
+
+  /// `key` was not found at `now`, _mutex must be held
+  void rememberMissing(std::string key, int64_t now);
+
+ private:
+  std::string const _root;
+  size_t const _maxOpenFiles;
+
+  std::mutex _mutex;
+  std::unordered_map<std::string, Entry> _files;
+  /// paths not found, steady clock seconds of the failed lookup
+  std::unordered_map<std::string, int64_t> _missing;
+};
+
+}}  // namespace asiodemo::rest
+
+#endif
@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace asiodemo::rest;
+
+namespace {
+constexpr uint64_t SlotMask = TimerWheel::NumSlots - 1;
+/// the largest delay the wheel can represent, longer ones are clamped
+constexpr uint64_t MaxDelay =
+    (uint64_t(1) << (TimerWheel::SlotBits * TimerWheel::NumLevels)) - 1;
+}  // namespace
+
+void TimerWheel::schedule(Entry& entry, std::chrono::seconds timeout) {
+  entry.cancel();
+  uint64_t delay = static_cast<uint64_t>(std::max<int64_t>(1, timeout.count()));
+  entry._expires = _now + std::min(delay, MaxDelay);
+  insert(entry);
+}
+
+void TimerWheel::insert(Entry& entry) {
+  // entries due in this tick only come from a cascade, they go into the
+  // current level 0 slot which is expired right afterwards
+  uint64_t delay = entry._expires > _now ? entry._expires - _now : 0;
+  uint64_t expires = _now + delay;
+  unsigned level = 0;
+  while (level + 1 < NumLevels &&
+         delay >= (uint64_t(1) << ((level + 1) * SlotBits))) {
+    ++level;
+  }
+  uint64_t slot = (expires >> (level * SlotBits)) & SlotMask;
+  entry.linkBefore(&_slots[level][slot]);
+}
+
+void TimerWheel::cascade(unsigned level, uint64_t slot) {
+  Entry& head = _slots[level][slot];
+  while (head.armed()) {
+    Entry* entry = head._next;
+    entry->cancel();
+    insert(*entry);
+  }
+}
+
+void TimerWheel::tick() {
+  ++_now;
+
+  // once a level wrapped around, the next slot of the level above it
+  // holds the entries due within its range
+  for (unsigned level = 1; level < NumLevels; ++level) {
+    if ((_now & ((uint64_t(1) << (level * SlotBits)) - 1)) != 0) {
+      break;
+    }
+    cascade(level, (_now >> (level * SlotBits)) & SlotMask);
+  }
+
+  // detach the due entries first, callbacks may (re-)schedule entries
+  Entry due;
+  Entry& head = _slots[0][_now & SlotMask];
+  if (!head.armed()) {
+    return;
+  }
+  due._next = head._next;
+  due._prev = head._prev;
+  due._next->_prev = &due;
+  due._prev->_next = &due;
+  head._prev = head._next = &head;
+
+  while (due.armed()) {
+    Entry* entry = due._next;
+    entry->cancel();
+    assert(entry->_expires <= _now);
+    if (entry->callback) {
+      entry->callback();
+    }
+  }
+}
@@ -0,0 +1,88 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H 1
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+namespace asiodemo { namespace rest {
+
+/// Hierarchical timing wheel with a resolution of one tick (one second,
+/// driven by IoContext). Level 0 has a slot per tick for the next 64
+/// ticks, every further level covers 64 times the range of the previous
+/// one and is cascaded down when the lower level wraps around.
+/// Entries are intrusive, scheduling and cancelling are O(1) and never
+/// allocate. Not thread-safe, a wheel belongs to one io thread.
+class TimerWheel {
+ public:
+  static constexpr unsigned SlotBits = 6;
+  static constexpr uint64_t NumSlots = 1 << SlotBits;
+  static constexpr unsigned NumLevels = 4;
+
+  /// a timeout, embedded into the object it guards
+  class Entry {
+   public:
+    Entry() : _prev(this), _next(this), _expires(0) {}
+    ~Entry() { cancel(); }
+
+    Entry(Entry const&) = delete;
+    Entry& operator=(Entry const&) = delete;
+
+    bool armed() const { return _next != this; }
+
+    void cancel() {
+      _prev->_next = _next;
+      _next->_prev = _prev;
+      _prev = _next = this;
+    }
+
+    /// called on the io thread when the timeout expires, the entry is
+    /// unlinked before. Set once by the owner, not on every schedule
+    std::function<void()> callback;
+
+   private:
+    friend class TimerWheel;
+
+    void linkBefore(Entry* head) {
+      _prev = head->_prev;
+      _next = head;
+      head->_prev->_next = this;
+      head->_prev = this;
+    }
+
+    Entry* _prev;
+    Entry* _next;
+    uint64_t _expires;
+  };
+
+  TimerWheel() : _now(0) {}
+  TimerWheel(TimerWheel const&) = delete;
+  TimerWheel& operator=(TimerWheel const&) = delete;
+
+  /// ticks since the wheel was created
+  uint64_t now() const { return _now; }
+
+  /// (re-)arm an entry, fires after at least `timeout` (minimum one tick)
+  void schedule(Entry& entry, std::chrono::seconds timeout);
+
+  /// advance by one tick and run the callbacks of the expired entries
+  void tick();
+
+ private:
+  void insert(Entry& entry);
+  /// move the entries of a slot to lower levels
+  void cascade(unsigned level, uint64_t slot);
+
+ private:
+  uint64_t _now;
+  /// list heads, an empty slot points to itself
+  Entry _slots[NumLevels][NumSlots];
+};
+
+}}  // namespace asiodemo::rest
+
+#endif
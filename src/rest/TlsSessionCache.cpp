@@ -0,0 +1,283 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "TlsSessionCache.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+using namespace asiodemo::rest;
+
+namespace {
+
+int64_t steadySeconds() {
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/// SSL_CTX ex data slot pointing to the TlsSessionCache
+int contextIndex() {
+  static int const index =
+      SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return index;
+}
+
+std::string sessionId(unsigned char const* id, unsigned len) {
+  return std::string(reinterpret_cast<char const*>(id), len);
+}
+
+}  // namespace
+
+struct TlsSessionCache::Callbacks {
+  static TlsSessionCache* fromContext(SSL_CTX* ctx) {
+    return static_cast<TlsSessionCache*>(
+        SSL_CTX_get_ex_data(ctx, contextIndex()));
+  }
+
+  static int newSession(SSL* ssl, SSL_SESSION* session) {
+    TlsSessionCache* cache = fromContext(SSL_get_SSL_CTX(ssl));
+    unsigned len;
+    unsigned char const* id = SSL_SESSION_get_id(session, &len);
+    int size = i2d_SSL_SESSION(session, nullptr);
+    if (cache == nullptr || len == 0 || size <= 0) {
+      return 0;
+    }
+    Entry entry;
+    entry.der.resize(size);
+    unsigned char* p = reinterpret_cast<unsigned char*>(&entry.der[0]);
+    i2d_SSL_SESSION(session, &p);
+    entry.expires = steadySeconds() + SSL_SESSION_get_timeout(session);
+
+    std::string key = sessionId(id, len);
+    Shard& shard = cache->shard(key);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    if (shard.sessions.size() >= cache->_capacityPerShard) {
+      // evict the oldest of a few sessions
+      auto victim = shard.sessions.begin();
+      auto it = victim;
+      for (int i = 0; i < 8 && it != shard.sessions.end(); ++i, ++it) {
+        if (it->second.expires < victim->second.expires) {
+          victim = it;
+        }
+      }
+      shard.sessions.erase(victim);
+    }
+    shard.sessions[std::move(key)] = std::move(entry);
+    return 0;  // the session is serialized, OpenSSL keeps its reference
+  }
+
+  static SSL_SESSION* getSession(SSL* ssl, unsigned char const* id, int len,
+                                 int* copy) {
+    *copy = 0;  // the returned session is owned by OpenSSL
+    TlsSessionCache* cache = fromContext(SSL_get_SSL_CTX(ssl));
+    if (cache == nullptr || len <= 0) {
+      return nullptr;
+    }
+    std::string key = sessionId(id, static_cast<unsigned>(len));
+    std::string der;
+    {
+      Shard& shard = cache->shard(key);
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      auto it = shard.sessions.find(key);
+      if (it != shard.sessions.end()) {
+        if (it->second.expires > steadySeconds()) {
+          der = it->second.der;
+        } else {
+          shard.sessions.erase(it);
+        }
+      }
+    }
+    if (der.empty()) {
+      cache->_stats.cacheMisses.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    cache->_stats.cacheHits.fetch_add(1, std::memory_order_relaxed);
+    auto const* p = reinterpret_cast<unsigned char const*>(der.data());
+    return d2i_SSL_SESSION(nullptr, &p, static_cast<long>(der.size()));
+  }
+
+  static void removeSession(SSL_CTX* ctx, SSL_SESSION* session) {
+    TlsSessionCache* cache = fromContext(ctx);
+    unsigned len;
+    unsigned char const* id = SSL_SESSION_get_id(session, &len);
+    if (cache == nullptr || len == 0) {
+      return;
+    }
+    std::string key = sessionId(id, len);
+    Shard& shard = cache->shard(key);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    shard.sessions.erase(key);
+  }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  static int ticket(SSL* ssl, unsigned char* name, unsigned char* iv,
+                    EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int enc) {
+#else
+  static int ticket(SSL* ssl, unsigned char* name, unsigned char* iv,
+                    EVP_CIPHER_CTX* cipher, HMAC_CTX* mac, int enc) {
+#endif
+    TlsSessionCache* cache = fromContext(SSL_get_SSL_CTX(ssl));
+    TicketKey key;
+    int res = cache == nullptr ? 0 : cache->ticketKey(name, enc == 1, key);
+    if (res == 0) {
+      // no ticket is issued, or the ticket is ignored
+      return 0;
+    }
+    if (enc == 1 && RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1) {
+      return -1;
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    char digest[] = "SHA256";
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY,
+                                          key.hmacKey.data(),
+                                          key.hmacKey.size()),
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+        OSSL_PARAM_construct_end()};
+    if (EVP_MAC_CTX_set_params(mac, params) != 1) {
+      return -1;
+    }
+#else
+    if (HMAC_Init_ex(mac, key.hmacKey.data(), key.hmacKey.size(),
+                     EVP_sha256(), nullptr) != 1) {
+      return -1;
+    }
+#endif
+    int ok = enc == 1 ? EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr,
+                                           key.aesKey.data(), iv)
+                      : EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr,
+                                           key.aesKey.data(), iv);
+    return ok == 1 ? res : -1;
+  }
+};
+
+TlsSessionCache::TlsSessionCache(size_t capacity,
+                                 std::chrono::seconds keyRotation)
+    : _capacityPerShard((capacity + NumShards - 1) / NumShards),
+      _keyRotation(keyRotation.count()) {}
+
+TlsSessionCache::~TlsSessionCache() {
+  // the ticket keys must not linger in freed memory
+  for (TicketKey& key : _keys) {
+    OPENSSL_cleanse(&key, sizeof(key));
+  }
+}
+
+void TlsSessionCache::attach(SSL_CTX* ctx) {
+  SSL_CTX_set_ex_data(ctx, contextIndex(), this);
+
+  // any id works, resumed sessions must belong to this server
+  static unsigned char const sidContext[] = "asiodemo";
+  SSL_CTX_set_session_id_context(ctx, sidContext, sizeof(sidContext) - 1);
+
+  if (_capacityPerShard > 0) {
+    SSL_CTX_set_session_cache_mode(
+        ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL |
+                 SSL_SESS_CACHE_NO_AUTO_CLEAR);
+    SSL_CTX_sess_set_new_cb(ctx, &Callbacks::newSession);
+    SSL_CTX_sess_set_get_cb(ctx, &Callbacks::getSession);
+    SSL_CTX_sess_set_remove_cb(ctx, &Callbacks::removeSession);
+  } else {
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+  }
+
+  if (_keyRotation > 0) {
+    // tickets stay valid for at least one rotation period
+    SSL_CTX_set_timeout(ctx, static_cast<long>(_keyRotation));
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, &Callbacks::ticket);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(ctx, &Callbacks::ticket);
+#endif
+  } else {
+    SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+  }
+}
+
+void TlsSessionCache::recordHandshake(SSL const* ssl) {
+  if (SSL_session_reused(const_cast<SSL*>(ssl))) {
+    _stats.resumedHandshakes.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    _stats.fullHandshakes.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+double TlsSessionCache::hitRate() const {
+  uint64_t resumed = _stats.resumedHandshakes.load(std::memory_order_relaxed);
+  uint64_t total =
+      resumed + _stats.fullHandshakes.load(std::memory_order_relaxed);
+  return total == 0 ? 0.0 : double(resumed) / double(total);
+}
+
+TlsSessionCache::Shard& TlsSessionCache::shard(std::string const& id) {
+  return _shards[std::hash<std::string>()(id) % NumShards];
+}
+
+bool TlsSessionCache::rotateKeys(int64_t now) {
+  {
+    std::shared_lock<std::shared_mutex> guard(_keysMutex);
+    if (!_keys.empty() && now - _keys.front().created < _keyRotation) {
+      return true;
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> guard(_keysMutex);
+  if (!_keys.empty() && now - _keys.front().created < _keyRotation) {
+    return true;  // rotated by another thread meanwhile
+  }
+  TicketKey key;
+  if (RAND_bytes(key.name.data(), key.name.size()) != 1 ||
+      RAND_bytes(key.aesKey.data(), key.aesKey.size()) != 1 ||
+      RAND_bytes(key.hmacKey.data(), key.hmacKey.size()) != 1) {
+    LOG_ERROR("unable to generate a TLS session ticket key");
+    return !_keys.empty();
+  }
+  key.created = now;
+  if (!_keys.empty() && now - _keys.front().created >= 2 * _keyRotation) {
+    // idle for two periods, the previous key has expired as well
+    _keys.clear();
+  }
+  _keys.insert(_keys.begin(), key);
+  while (_keys.size() > 2) {
+    OPENSSL_cleanse(&_keys.back(), sizeof(TicketKey));
+    _keys.pop_back();
+  }
+  _stats.keyRotations.fetch_add(1, std::memory_order_relaxed);
+  LOG_DEBUG("rotated TLS session ticket key");
+  return true;
+}
+
+int TlsSessionCache::ticketKey(unsigned char* name, bool enc,
+                               TicketKey& out) {
+  if (!rotateKeys(steadySeconds())) {
+    return 0;
+  }
+  std::shared_lock<std::shared_mutex> guard(_keysMutex);
+  if (enc) {
+    out = _keys.front();
+    std::memcpy(name, out.name.data(), out.name.size());
+    return 1;
+  }
+  for (size_t i = 0; i < _keys.size(); ++i) {
+    if (std::memcmp(name, _keys[i].name.data(), _keys[i].name.size()) == 0) {
+      out = _keys[i];
+      return i == 0 ? 1 : 2;  // renew tickets of the previous key
+    }
+  }
+  _stats.ticketsRejected.fetch_add(1, std::memory_order_relaxed);
+  return 0;
+}
@@ -0,0 +1,104 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TLS_SESSION_CACHE_H
+#define TLS_SESSION_CACHE_H 1
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <openssl/ssl.h>
+
+namespace asiodemo { namespace rest {
+
+/// Server side TLS session resumption for one SSL_CTX:
+///  - a sharded in-process session cache replacing OpenSSL's internal one
+///    (which has a single lock), used for session ids
+///  - stateless session tickets encrypted with in-memory keys that are
+///    rotated periodically. Tickets of the previous key are still
+///    accepted and renewed.
+/// The callbacks run concurrently on the io threads.
+class TlsSessionCache {
+ public:
+  struct Stats {
+    std::atomic<uint64_t> fullHandshakes{0};
+    std::atomic<uint64_t> resumedHandshakes{0};
+    /// session id lookups
+    std::atomic<uint64_t> cacheHits{0};
+    std::atomic<uint64_t> cacheMisses{0};
+    /// tickets with an unknown (expired) key
+    std::atomic<uint64_t> ticketsRejected{0};
+    std::atomic<uint64_t> keyRotations{0};
+  };
+
+  /// `capacity` sessions are cached, 0 disables the cache. Ticket keys
+  /// are replaced every `keyRotation`, 0 disables tickets
+  TlsSessionCache(size_t capacity, std::chrono::seconds keyRotation);
+  ~TlsSessionCache();
+
+  /// install the callbacks, the cache must outlive `ctx`
+  void attach(SSL_CTX* ctx);
+
+  /// count a completed handshake
+  void recordHandshake(SSL const* ssl);
+
+  Stats const& stats() const { return _stats; }
+  /// share of resumed handshakes
+  double hitRate() const;
+
+ private:
+  static constexpr size_t NumShards = 16;
+
+  struct Entry {
+    /// i2d_SSL_SESSION() encoding
+    std::string der;
+    int64_t expires;
+  };
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> sessions;
+  };
+
+  struct TicketKey {
+    std::array<unsigned char, 16> name;
+    std::array<unsigned char, 32> aesKey;
+    std::array<unsigned char, 32> hmacKey;
+    int64_t created;
+  };
+
+  /// the OpenSSL callbacks
+  struct Callbacks;
+
+  Shard& shard(std::string const& id);
+
+  /// rotate if the current key is too old, returns false if no key could
+  /// be generated
+  bool rotateKeys(int64_t now);
+  /// key for a new ticket (`enc`) or the one a ticket was encrypted with.
+  /// Returns 0 if unknown, 2 if the ticket should be renewed, else 1
+  int ticketKey(unsigned char* name, bool enc, TicketKey& out);
+
+ private:
+  size_t const _capacityPerShard;
+  int64_t const _keyRotation;
+
+  Shard _shards[NumShards];
+
+  /// current key first, then the previous one
+  std::shared_mutex _keysMutex;
+  std::vector<TicketKey> _keys;
+
+  Stats _stats;
+};
+
+}}  // namespace asiodemo::rest
+
+#endif
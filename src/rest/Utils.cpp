@@ -1,5 +1,7 @@
 #include "Utils.h"
 
+#include <cstring>
+
 namespace asiodemo { namespace utils {
 
 using namespace asiodemo::rest;
@@ -37,14 +39,45 @@ void tolowerInPlace(std::string& str) {
   }
 }
 
-std::string trim(std::string const& sourceStr, std::string const& trimStr) {
+void tolowerInPlace(char* str, size_t len) {
+  for (char* end = str + len; str != end; ++str) {
+    *str = ::tolower(*str);
+  }
+}
+
+size_t formatUInt(uint64_t value, char* out) {
+  static constexpr char digits[] =
+      "0001020304050607080910111213141516171819202122232425262728293031323334"
+      "3536373839404142434445464748495051525354555657585960616263646566676869"
+      "707172737475767778798081828384858687888990919293949596979899";
+  char buf[20];
+  char* p = buf + sizeof(buf);
+  while (value >= 100) {
+    size_t i = static_cast<size_t>(value % 100) * 2;
+    value /= 100;
+    *--p = digits[i + 1];
+    *--p = digits[i];
+  }
+  if (value >= 10) {
+    size_t i = static_cast<size_t>(value) * 2;
+    *--p = digits[i + 1];
+    *--p = digits[i];
+  } else {
+    *--p = static_cast<char>('0' + value);
+  }
+  size_t len = buf + sizeof(buf) - p;
+  std::memcpy(out, p, len);
+  return len;
+}
+
+std::string_view trim(std::string_view sourceStr, std::string_view trimStr) {
   size_t s = sourceStr.find_first_not_of(trimStr);
   size_t e = sourceStr.find_last_not_of(trimStr);
 
-  if (s == std::string::npos) {
-    return std::string();
+  if (s == std::string_view::npos) {
+    return std::string_view();
   } else {
-    return std::string(sourceStr, s, e - s + 1);
+    return sourceStr.substr(s, e - s + 1);
   }
 }
 
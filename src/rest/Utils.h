@@ -5,9 +5,14 @@ namespace asiodemo { namespace utils {
 
 rest::Request::Type llhttpToRequestType(llhttp_t* p);
 void tolowerInPlace(std::string& str);
+void tolowerInPlace(char* str, size_t len);
+
+/// @brief writes the decimal representation of `value` to `out`
+/// (at least 20 bytes), returns the number of bytes written
+size_t formatUInt(uint64_t value, char* out);
 
 /// @brief removes leading and trailing whitespace
-std::string trim(std::string const& sourceStr,
-                 std::string const& trimStr = " \t\n\r");
+std::string_view trim(std::string_view sourceStr,
+                      std::string_view trimStr = " \t\n\r");
 
 }}  // namespace asiodemo::utils
\ No newline at end of file
@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @author Simon Grätzer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H 1
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <utility>
+
+#include <asio/post.hpp>
+#include <asio/thread_pool.hpp>
+
+#include "Logger.h"
+
+namespace asiodemo { namespace rest {
+
+/// Threads for slow or cpu heavy handlers, so they do not stall the io
+/// threads. The number of queued and running jobs is bounded, callers
+/// reserve a slot with tryAcquire() and reject the work if there is none.
+class WorkerPool {
+ public:
+  WorkerPool(size_t threads, size_t maxInFlight)
+      : _pool(threads),
+        _maxInFlight(maxInFlight),
+        _inFlight(0),
+        _rejected(0) {}
+  ~WorkerPool() { stop(); }
+
+  WorkerPool(WorkerPool const&) = delete;
+  WorkerPool& operator=(WorkerPool const&) = delete;
+
+  /// reserve a slot for one job, false if the pool is saturated
+  bool tryAcquire() {
+    size_t n = _inFlight.load(std::memory_order_relaxed);
+    do {
+      if (n >= _maxInFlight) {
+        _rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+    } while (!_inFlight.compare_exchange_weak(n, n + 1,
+                                              std::memory_order_relaxed));
+    return true;
+  }
+
+  /// run fn on a worker thread, requires a slot from tryAcquire()
+  template <typename F>
+  void post(F&& fn) {
+    asio::post(_pool, [this, fn = std::forward<F>(fn)]() mutable {
+      try {
+        fn();
+      } catch (std::exception const& ex) {
+        LOG_WARN("worker job failed: ", std::string(ex.what()));
+      } catch (...) {
+        LOG_WARN("worker job failed");
+      }
+      _inFlight.fetch_sub(1, std::memory_order_relaxed);
+    });
+  }
+
+  /// wait for the queued jobs and join the threads
+  void stop() { _pool.join(); }
+
+  size_t inFlight() const { return _inFlight.load(std::memory_order_relaxed); }
+  /// jobs turned away because the pool was saturated
+  uint64_t rejected() const {
+    return _rejected.load(std::memory_order_relaxed);
+  }
+
+ private:
+  asio::thread_pool _pool;
+  size_t const _maxInFlight;
+  std::atomic<size_t> _inFlight;
+  std::atomic<uint64_t> _rejected;
+};
+
+}}  // namespace asiodemo::rest
+
+#endif